@@ -6,111 +6,165 @@
 /* Includes */
 #include <stdint.h>
 #include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "cpu6502_opcodes.h"
 
 /* Constants */
-/* Size of RAM, in bytes */
+/* Size of RAM, in bytes (it is allocated sparsely, so it may be made larger) */
+#if !defined(RAM_SIZE)
 #define RAM_SIZE            (2*1024*1024)
+#endif
 /* Size of a page, in bytes */
 #define PAGE_SIZE           256
+/* Number of pages of RAM */
+#define PAGE_COUNT          (RAM_SIZE/PAGE_SIZE)
+/* Size of a block of RAM, the unit it is allocated in: 64 pages */
+#define BLOCK_SIZE          (64*PAGE_SIZE)
+/* Number of blocks of RAM */
+#define BLOCK_COUNT         (RAM_SIZE/BLOCK_SIZE)
+#if RAM_SIZE % BLOCK_SIZE != 0
+#error "RAM_SIZE must be a whole number of blocks"
+#endif
+/* Number of pages in the 64KiB address space */
+#define ADDR_PAGE_COUNT     (0x10000/PAGE_SIZE)
+/* Size of a host cache line, in bytes */
+#define CACHE_LINE_SIZE     64
+/* Maximum number of bank select registers */
+#define MAX_BANKS           8
+/* Maximum number of devices on a machine, or in its description */
+#define MAX_DEVICES         16
 /* NMI Interrupt vector */
 #define NMI_VECTOR          0xfffa
 /* IRQ Interrupt vector */
 #define IRQ_VECTOR          0xfffe
 /* RESET Interrupt vector */
 #define RESET_VECTOR        0xfffc
+/* Address a routine run by cpu6502_call returns to */
+#define CALL_SENTINEL       0xffff
 
-/* Addressing modes */
-enum addressing_modes_6502 {
-  ADDR_MODE_ACCUMULATOR=0,  /* The value in a */
-  ADDR_MODE_ABSOLUTE=1,     /* The value at immediate address */
-  ADDR_MODE_ABSOLUTE_X=3,   /* the value at immediate address + x */
-  ADDR_MODE_ABSOLUTE_Y=4,   /* the value at immediate address + y */
-  ADDR_MODE_IMMEDIATE=5,    /* The immediate value */
-  ADDR_MODE_IMPLIED=6,      /* No value needed or value implied by instruction */
-  ADDR_MODE_INDIRECT=7,     /* The value at address at immediate address */
-  ADDR_MODE_INDIRECT_X=8,   /* The value at address at (immediate address + x) */
-  ADDR_MODE_INDIRECT_Y=9,   /* (The value at address at immediate address) + y */
-  ADDR_MODE_RELATIVE=10,     /* The value is the program counter + immediate */
-  ADDR_MODE_ZERO_PAGE=11,    /* The value at immediate address in zero page */
-  ADDR_MODE_ZERO_PAGE_X=12,  /* The value at immediate address in zero page + x */
-  ADDR_MODE_ZERO_PAGE_Y=13,  /* The value at immediate address in zero page + y */
-  ADDR_MODE_NONE=14,         /* Empty space in instruction set */
+/*
+ * Code placement by how often it runs. Hot code is kept together in one
+ * section, so the dispatch loop and common handlers share few cache lines
+ * and pages. Warm code gets a section of its own next to it, rather than
+ * being scattered through the rest of the program's text, and cold code
+ * goes where the toolchain keeps unlikely code.
+ */
+#if defined(__GNUC__) && defined(__ELF__)
+#define CPU6502_HOT \
+  __attribute__((hot, section(".text.hot.cpu6502")))
+#define CPU6502_WARM \
+  __attribute__((section(".text.warm.cpu6502")))
+#define CPU6502_COLD \
+  __attribute__((cold, section(".text.unlikely.cpu6502")))
+#elif defined(__GNUC__)
+#define CPU6502_HOT         __attribute__((hot))
+#define CPU6502_WARM
+#define CPU6502_COLD        __attribute__((cold))
+#else
+#define CPU6502_HOT
+#define CPU6502_WARM
+#define CPU6502_COLD
+#endif
+
+/* Pairs of instructions run as one superinstruction */
+enum fused_pairs_6502 {
+  FUSED_PAIR_NONE=0,        /* Not fused */
+  FUSED_PAIR_COMPARE_BRANCH=1, /* CMP, CPX or CPY, then BNE or BEQ */
+  FUSED_PAIR_LOAD_STORE=2,  /* LDA, then STA */
+  FUSED_PAIR_COUNT_BRANCH=3, /* DEX or DEY, then BNE */
+  FUSED_PAIR_CLEAR_ADD=4,   /* CLC, then ADC */
+};
+
+/* Flags of a page of the address space */
+enum page_flags_6502 {
+  PAGE_FLAG_ROM=1,          /* Writes are ignored */
+  PAGE_FLAG_IO=2,           /* Holds device registers */
+  PAGE_FLAG_BANK=4,         /* Holds a bank select register */
+  PAGE_FLAG_LOG=8,          /* Writes are passed to the write hook */
+  PAGE_FLAG_TRACE=16,       /* Jumps from or to it go to the branch hook */
+};
+/* Flags that take a write to a page off the fast path */
+#define PAGE_FLAGS_WRITE \
+  (PAGE_FLAG_ROM | PAGE_FLAG_IO | PAGE_FLAG_BANK | PAGE_FLAG_LOG)
+
+/* Kinds of control transfer */
+enum branch_kinds_6502 {
+  BRANCH_KIND_BRANCH=0,     /* Taken conditional branch */
+  BRANCH_KIND_JUMP=1,       /* Jump, or the host moving the PC */
+  BRANCH_KIND_CALL=2,       /* Subroutine call */
+  BRANCH_KIND_RETURN=3,     /* Return from subroutine or interrupt */
+  BRANCH_KIND_INTERRUPT=4,  /* Interrupt or reset */
+};
+
+/* Why running a machine stopped */
+enum stop_reasons_6502 {
+  STOP_REASON_NONE=0,       /* It hasn't stopped */
+  STOP_REASON_RETURNED=1,   /* The called routine returned */
+  STOP_REASON_CYCLE_LIMIT=2, /* It ran out of cycles */
+  STOP_REASON_LOOP=3,       /* It is stuck in a loop, by the watchdog */
+  STOP_REASON_CPU_TIME=4,   /* It used up its host CPU time */
+  STOP_REASON_MEMORY=5,     /* It used up its memory */
+  STOP_REASON_OUTPUT=6,     /* It used up its output */
+};
+
+/* Registers after cpu6502_call */
+struct cpu6502_call_result {
+  enum stop_reasons_6502 reason; /* Why the call stopped */
+  uint8_t a;            /* Accumulator */
+  uint8_t x;            /* Index register X */
+  uint8_t y;            /* Index register Y */
+  uint8_t status;       /* Status register */
+  uint8_t sp;           /* Stack pointer */
+  uint64_t cycles;      /* Number of cycles run */
 };
-/* Instruction types */
-enum instr_types_6502 {
-  /* Load/store */
-  INSTR_TYPE_LDA=0,         /* Load accumulator */
-  INSTR_TYPE_LDX=1,         /* Load X register */
-  INSTR_TYPE_LDY=2,         /* Load Y register */
-  INSTR_TYPE_STA=3,         /* Store accumulator */
-  INSTR_TYPE_STX=4,         /* Store X register */
-  INSTR_TYPE_STY=5,         /* Store Y register */
-  /* Register transfers */
-  INSTR_TYPE_TAX=6,         /* Transfer accumulator to X */
-  INSTR_TYPE_TAY=7,         /* Transfer accumulator to Y */
-  INSTR_TYPE_TXA=8,         /* Transfer X to accumulator */
-  INSTR_TYPE_TYA=9,         /* Transfer Y to accumulator */
-  /* Stack operations */
-  INSTR_TYPE_TSX=10,        /* Transfer stack pointer to X */
-  INSTR_TYPE_TXS=12,        /* Transfer X to stack pointer */
-  INSTR_TYPE_PHA=13,        /* Push accumulator */
-  INSTR_TYPE_PHP=14,        /* Push status register */
-  INSTR_TYPE_PLA=15,        /* Pop accumulator */
-  INSTR_TYPE_PLP=16,        /* Pop status register */
-  /* Logical */
-  INSTR_TYPE_AND=17,        /* Logical AND */
-  INSTR_TYPE_EOR=18,        /* Exclusive OR */
-  INSTR_TYPE_ORA=19,        /* Logical OR */
-  INSTR_TYPE_BIT=20,        /* Bit test */
-  /* Arithmetic */
-  INSTR_TYPE_ADC=21,        /* Add with carry */
-  INSTR_TYPE_SBC=22,        /* Subtract with carry */
-  INSTR_TYPE_CMP=23,        /* Compare to accumulator */
-  INSTR_TYPE_CPX=24,        /* Compare to X register */
-  INSTR_TYPE_CPY=25,        /* Compare to Y register */
-  /* Increments & Decrements */
-  INSTR_TYPE_INC=26,        /* Increment memory */
-  INSTR_TYPE_INX=27,        /* Increment X register */
-  INSTR_TYPE_INY=28,        /* Increment Y register */
-  INSTR_TYPE_DEC=29,        /* Decrement memory */
-  INSTR_TYPE_DEX=30,        /* Decrement X register */
-  INSTR_TYPE_DEY=31,        /* Decrement Y register */
-  /* Shifts */
-  INSTR_TYPE_ASL=32,        /* Arithmetic shift left */
-  INSTR_TYPE_LSR=33,        /* Logical shift right */
-  INSTR_TYPE_ROL=34,        /* Rotate left */
-  INSTR_TYPE_ROR=35,        /* Rotate right */
-  /* Jumps & calls */
-  INSTR_TYPE_JMP=36,        /* Jump to address */
-  INSTR_TYPE_JSR=37,        /* Jump to subroutine */
-  INSTR_TYPE_RTS=38,        /* Return from subroutine */
-  /* Branches */
-  INSTR_TYPE_BCC=39,        /* Branch on carry clear */
-  INSTR_TYPE_BCS=40,        /* Branch on carry set */
-  INSTR_TYPE_BEQ=41,        /* Branch on zero set */
-  INSTR_TYPE_BMI=42,        /* Branch on result minus */
-  INSTR_TYPE_BNE=43,        /* Branch on zero clear */
-  INSTR_TYPE_BPL=44,        /* Branch on result positive */
-  INSTR_TYPE_BVC=45,        /* Branch on overflow clear */
-  INSTR_TYPE_BVS=46,        /* Branch on overflow set */
-  /* Status flag changes */
-  INSTR_TYPE_CLC=47,        /* Clear carry flag */
-  INSTR_TYPE_CLD=48,        /* Clear decimal flag */
-  INSTR_TYPE_CLI=49,        /* Clear interrupt disable flag */
-  INSTR_TYPE_CLV=50,        /* Clear overflow flag */
-  INSTR_TYPE_SEC=51,        /* Set carry flag */
-  INSTR_TYPE_SED=52,        /* Set decimal flag */
-  INSTR_TYPE_SEI=53,        /* Set interrupt disable flag */
-  /* System functions */
-  INSTR_TYPE_BRK=54,        /* Force interrupt */
-  INSTR_TYPE_NOP=55,        /* No operation */
-  INSTR_TYPE_RTI=56,        /* Return from interrupt */
-  /* None */
-  INSTR_TYPE_NONE=47,       /* Empty space in instruction set */
+
+/* A window of the address space that banks of RAM are switched into */
+struct cpu6502_bank {
+  uint16_t reg;         /* Address of the bank select register */
+  uint16_t window;      /* First address of the window, page aligned */
+  uint32_t size;        /* Size of the window and of each bank, in bytes */
+  uint32_t base;        /* Offset in RAM of bank 0 */
+  uint32_t count;       /* Number of banks */
+};
+
+struct cpu6502;
+
+/* Called before a write to a page flagged PAGE_FLAG_LOG lands in RAM */
+typedef void (*cpu6502_write_fn)(
+    struct cpu6502 *cpu, uint16_t addr, uint8_t value, void *ctx);
+/* Called as the PC jumps from or to a page flagged PAGE_FLAG_TRACE */
+/* Everything else the instruction does is done by then, but the PC is at from */
+typedef void (*cpu6502_branch_fn)(struct cpu6502 *cpu,
+    enum branch_kinds_6502 kind, uint16_t from, uint16_t to, void *ctx);
+/* Called for reads of a page flagged PAGE_FLAG_IO, instead of RAM */
+typedef uint8_t (*cpu6502_io_read_fn)(
+    struct cpu6502 *cpu, uint16_t addr, void *ctx);
+/* Called for writes to a page flagged PAGE_FLAG_IO (nonzero if it took it) */
+typedef int (*cpu6502_io_write_fn)(
+    struct cpu6502 *cpu, uint16_t addr, uint8_t value, void *ctx);
+/* Called between instructions once the cycle counter reaches due_cycle */
+typedef void (*cpu6502_due_fn)(struct cpu6502 *cpu, void *ctx);
+
+/* Host wiring, kept by a machine when state is copied into it */
+struct cpu6502_hooks {
+  cpu6502_write_fn write;   /* Called for writes to logged pages, or NULL */
+  void *write_ctx;          /* Passed to the write hook */
+  cpu6502_branch_fn branch; /* Called for control transfers, or NULL */
+  void *branch_ctx;         /* Passed to the branch hook */
+  cpu6502_io_read_fn io_read; /* Called for reads of I/O pages, or NULL */
+  cpu6502_io_write_fn io_write; /* Called for writes to I/O pages, or NULL */
+  void *io_ctx;             /* Passed to the I/O hooks */
+  cpu6502_due_fn due;       /* Called when due_cycle is reached, or NULL */
+  void *due_ctx;            /* Passed to the due hook */
+  uint64_t due_cycle;       /* Cycle the due hook is next called at */
 };
 
 /* 6503 CPU structure */
 struct cpu6502 {
+  /* Cache line aligned, so machines in an array never share a line */
+  _Alignas(CACHE_LINE_SIZE)
   uint16_t pc;          /* Program counter */
   uint8_t sp;           /* Stack pointer = 0x0100 | sp */
   uint8_t a;            /* Accumulator */
@@ -129,576 +183,228 @@ struct cpu6502 {
       uint8_t n : 1;    /* Negative flag */
     } flags;            /* Status register flags */
   };
-  uint8_t ram[RAM_SIZE];/* RAM */
+  /* RAM, allocated a block at a time when first written */
+  uint8_t *blocks[BLOCK_COUNT]; /* Each block, or NULL if not allocated */
+  const uint8_t *read_blocks[BLOCK_COUNT]; /* Each block, or fill_block */
+  /* Pages written since last restore, a bit each (so a word per block) */
+  uint64_t dirty[BLOCK_COUNT];
+  /* Pages written since last copied to or from another machine */
+  uint64_t written[BLOCK_COUNT];
+  /* Power-on pattern; every block not allocated reads as this one */
+  uint8_t fill_block[BLOCK_SIZE];
   size_t ram_size;      /* Size of RAM, in bytes */
   size_t cycles_behind; /* Number of cycles the CPU is behind */
+  uint64_t cycles;      /* Number of cycles stepped since power on */
+  uint8_t nmi_pending;  /* An NMI edge is waiting to be serviced */
+  uint8_t irq_line;     /* The IRQ line is asserted */
+  uint64_t io_activity; /* Grows with each I/O page access and interrupt */
+  /* Extra cycles taken by an access to each page of the address space */
+  uint8_t wait_states[ADDR_PAGE_COUNT];
+  /* Offset in RAM each page of the address space is mapped to */
+  uint32_t page_map[ADDR_PAGE_COUNT];
+  /* Flags of each page of the address space */
+  uint8_t page_flags[ADDR_PAGE_COUNT];
+  struct cpu6502_bank banks[MAX_BANKS]; /* Bank switched windows */
+  size_t bank_count;    /* Number of bank switched windows */
+  struct cpu6502_hooks hooks; /* Host wiring */
   /* The current instruction mode */
   enum addressing_modes_6502 instruction_mode;
   /* The current data */
   uint8_t data;
 };
 
+/* Table entries, from the opcode list */
+#define CPU6502_MODE_ENTRY(opcode, mnemonic, mode, cycles, flags, heat) \
+  [opcode] = ADDR_MODE_##mode,
+#define CPU6502_TYPE_ENTRY(opcode, mnemonic, mode, cycles, flags, heat) \
+  [opcode] = INSTR_TYPE_##mnemonic,
+#define CPU6502_CYCLES_ENTRY(opcode, mnemonic, mode, cycles, flags, heat) \
+  [opcode] = cycles,
+#define CPU6502_FLAGS_ENTRY(opcode, mnemonic, mode, cycles, flags, heat) \
+  [opcode] = AFFECTS_##flags,
+#define CPU6502_NAME_ENTRY(opcode, mnemonic, mode, cycles, flags, heat) \
+  [opcode] = #mnemonic,
+
 /* Addressing modes for each instruction */
-static enum addressing_modes_6502 instruction_modes_6502[256] = {
-  [0x00] = ADDR_MODE_IMPLIED,
-  [0x01] = ADDR_MODE_INDIRECT_X,
-  [0x02] = ADDR_MODE_NONE,
-  [0x03] = ADDR_MODE_NONE,
-  [0x04] = ADDR_MODE_NONE,
-  [0x05] = ADDR_MODE_ZERO_PAGE,
-  [0x06] = ADDR_MODE_ZERO_PAGE,
-  [0x07] = ADDR_MODE_NONE,
-  [0x08] = ADDR_MODE_IMPLIED,
-  [0x09] = ADDR_MODE_IMMEDIATE,
-  [0x0a] = ADDR_MODE_ACCUMULATOR,
-  [0x0b] = ADDR_MODE_NONE,
-  [0x0c] = ADDR_MODE_NONE,
-  [0x0d] = ADDR_MODE_ABSOLUTE,
-  [0x0e] = ADDR_MODE_ABSOLUTE,
-  [0x0f] = ADDR_MODE_NONE,
-
-  [0x10] = ADDR_MODE_RELATIVE,
-  [0x11] = ADDR_MODE_INDIRECT_Y,
-  [0x12] = ADDR_MODE_NONE,
-  [0x13] = ADDR_MODE_NONE,
-  [0x14] = ADDR_MODE_NONE,
-  [0x15] = ADDR_MODE_ZERO_PAGE_X,
-  [0x16] = ADDR_MODE_ZERO_PAGE_X,
-  [0x17] = ADDR_MODE_NONE,
-  [0x18] = ADDR_MODE_IMPLIED,
-  [0x19] = ADDR_MODE_ABSOLUTE_Y,
-  [0x1a] = ADDR_MODE_NONE,
-  [0x1b] = ADDR_MODE_NONE,
-  [0x1c] = ADDR_MODE_NONE,
-  [0x1d] = ADDR_MODE_ABSOLUTE_X,
-  [0x1e] = ADDR_MODE_ABSOLUTE_X,
-  [0x1f] = ADDR_MODE_NONE,
-
-  [0x20] = ADDR_MODE_ABSOLUTE,
-  [0x21] = ADDR_MODE_INDIRECT_X,
-  [0x22] = ADDR_MODE_NONE,
-  [0x23] = ADDR_MODE_NONE,
-  [0x24] = ADDR_MODE_ZERO_PAGE,
-  [0x25] = ADDR_MODE_ZERO_PAGE,
-  [0x26] = ADDR_MODE_ZERO_PAGE,
-  [0x27] = ADDR_MODE_NONE,
-  [0x28] = ADDR_MODE_IMPLIED,
-  [0x29] = ADDR_MODE_IMMEDIATE,
-  [0x2a] = ADDR_MODE_ACCUMULATOR,
-  [0x2b] = ADDR_MODE_NONE,
-  [0x2c] = ADDR_MODE_ABSOLUTE,
-  [0x2d] = ADDR_MODE_ABSOLUTE,
-  [0x2e] = ADDR_MODE_ABSOLUTE,
-  [0x2f] = ADDR_MODE_NONE,
-
-  [0x30] = ADDR_MODE_RELATIVE,
-  [0x31] = ADDR_MODE_INDIRECT_Y,
-  [0x32] = ADDR_MODE_NONE,
-  [0x33] = ADDR_MODE_NONE,
-  [0x34] = ADDR_MODE_NONE,
-  [0x35] = ADDR_MODE_ZERO_PAGE_X,
-  [0x36] = ADDR_MODE_ZERO_PAGE_X,
-  [0x37] = ADDR_MODE_NONE,
-  [0x38] = ADDR_MODE_IMPLIED,
-  [0x39] = ADDR_MODE_ABSOLUTE_Y,
-  [0x3a] = ADDR_MODE_NONE,
-  [0x3b] = ADDR_MODE_NONE,
-  [0x3c] = ADDR_MODE_NONE,
-  [0x3d] = ADDR_MODE_ABSOLUTE_X,
-  [0x3e] = ADDR_MODE_ABSOLUTE_X,
-  [0x3f] = ADDR_MODE_NONE,
-
-  [0x40] = ADDR_MODE_IMPLIED,
-  [0x41] = ADDR_MODE_INDIRECT_X,
-  [0x42] = ADDR_MODE_NONE,
-  [0x43] = ADDR_MODE_NONE,
-  [0x44] = ADDR_MODE_NONE,
-  [0x45] = ADDR_MODE_ZERO_PAGE,
-  [0x46] = ADDR_MODE_ZERO_PAGE,
-  [0x47] = ADDR_MODE_NONE,
-  [0x48] = ADDR_MODE_IMPLIED,
-  [0x49] = ADDR_MODE_IMMEDIATE,
-  [0x4a] = ADDR_MODE_ACCUMULATOR,
-  [0x4b] = ADDR_MODE_NONE,
-  [0x4c] = ADDR_MODE_ABSOLUTE,
-  [0x4d] = ADDR_MODE_ABSOLUTE,
-  [0x4e] = ADDR_MODE_ABSOLUTE,
-  [0x4f] = ADDR_MODE_NONE,
-
-  [0x50] = ADDR_MODE_RELATIVE,
-  [0x51] = ADDR_MODE_INDIRECT_Y,
-  [0x52] = ADDR_MODE_NONE,
-  [0x53] = ADDR_MODE_NONE,
-  [0x54] = ADDR_MODE_NONE,
-  [0x55] = ADDR_MODE_ZERO_PAGE_X,
-  [0x56] = ADDR_MODE_ZERO_PAGE_X,
-  [0x57] = ADDR_MODE_NONE,
-  [0x58] = ADDR_MODE_IMPLIED,
-  [0x59] = ADDR_MODE_ABSOLUTE_Y,
-  [0x5a] = ADDR_MODE_NONE,
-  [0x5b] = ADDR_MODE_NONE,
-  [0x5c] = ADDR_MODE_NONE,
-  [0x5d] = ADDR_MODE_ABSOLUTE_X,
-  [0x5e] = ADDR_MODE_ABSOLUTE_X,
-  [0x5f] = ADDR_MODE_NONE,
-
-  [0x60] = ADDR_MODE_IMPLIED,
-  [0x61] = ADDR_MODE_INDIRECT_X,
-  [0x62] = ADDR_MODE_NONE,
-  [0x63] = ADDR_MODE_NONE,
-  [0x64] = ADDR_MODE_NONE,
-  [0x65] = ADDR_MODE_ZERO_PAGE,
-  [0x66] = ADDR_MODE_ZERO_PAGE,
-  [0x67] = ADDR_MODE_NONE,
-  [0x68] = ADDR_MODE_IMPLIED,
-  [0x69] = ADDR_MODE_IMMEDIATE,
-  [0x6a] = ADDR_MODE_ACCUMULATOR,
-  [0x6b] = ADDR_MODE_NONE,
-  [0x6c] = ADDR_MODE_INDIRECT,
-  [0x6d] = ADDR_MODE_ABSOLUTE,
-  [0x6e] = ADDR_MODE_ABSOLUTE,
-  [0x6f] = ADDR_MODE_NONE,
-
-  [0x70] = ADDR_MODE_RELATIVE,
-  [0x71] = ADDR_MODE_INDIRECT_Y,
-  [0x72] = ADDR_MODE_NONE,
-  [0x73] = ADDR_MODE_NONE,
-  [0x74] = ADDR_MODE_NONE,
-  [0x75] = ADDR_MODE_ZERO_PAGE_X,
-  [0x76] = ADDR_MODE_ZERO_PAGE_X,
-  [0x77] = ADDR_MODE_NONE,
-  [0x78] = ADDR_MODE_IMPLIED,
-  [0x79] = ADDR_MODE_ABSOLUTE_Y,
-  [0x7a] = ADDR_MODE_NONE,
-  [0x7b] = ADDR_MODE_NONE,
-  [0x7c] = ADDR_MODE_NONE,
-  [0x7d] = ADDR_MODE_ABSOLUTE_X,
-  [0x7e] = ADDR_MODE_ABSOLUTE_X,
-  [0x7f] = ADDR_MODE_NONE,
-
-  [0x80] = ADDR_MODE_NONE,
-  [0x81] = ADDR_MODE_INDIRECT_X,
-  [0x82] = ADDR_MODE_NONE,
-  [0x83] = ADDR_MODE_NONE,
-  [0x84] = ADDR_MODE_ZERO_PAGE,
-  [0x85] = ADDR_MODE_ZERO_PAGE,
-  [0x86] = ADDR_MODE_ZERO_PAGE,
-  [0x87] = ADDR_MODE_NONE,
-  [0x88] = ADDR_MODE_IMPLIED,
-  [0x89] = ADDR_MODE_NONE,
-  [0x8a] = ADDR_MODE_IMPLIED,
-  [0x8b] = ADDR_MODE_NONE,
-  [0x8c] = ADDR_MODE_ABSOLUTE,
-  [0x8d] = ADDR_MODE_ABSOLUTE,
-  [0x8e] = ADDR_MODE_ABSOLUTE,
-  [0x8f] = ADDR_MODE_NONE,
-
-  [0x90] = ADDR_MODE_RELATIVE,
-  [0x91] = ADDR_MODE_INDIRECT_Y,
-  [0x92] = ADDR_MODE_NONE,
-  [0x93] = ADDR_MODE_NONE,
-  [0x94] = ADDR_MODE_ZERO_PAGE_X,
-  [0x95] = ADDR_MODE_ZERO_PAGE_X,
-  [0x96] = ADDR_MODE_ZERO_PAGE_Y,
-  [0x97] = ADDR_MODE_NONE,
-  [0x98] = ADDR_MODE_IMPLIED,
-  [0x99] = ADDR_MODE_ABSOLUTE_Y,
-  [0x9a] = ADDR_MODE_IMPLIED,
-  [0x9b] = ADDR_MODE_NONE,
-  [0x9c] = ADDR_MODE_NONE,
-  [0x9d] = ADDR_MODE_ABSOLUTE_X,
-  [0x9e] = ADDR_MODE_NONE,
-  [0x9f] = ADDR_MODE_NONE,
-
-  [0xa0] = ADDR_MODE_IMMEDIATE,
-  [0xa1] = ADDR_MODE_INDIRECT_X,
-  [0xa2] = ADDR_MODE_IMMEDIATE,
-  [0xa3] = ADDR_MODE_NONE,
-  [0xa4] = ADDR_MODE_ZERO_PAGE,
-  [0xa5] = ADDR_MODE_ZERO_PAGE,
-  [0xa6] = ADDR_MODE_ZERO_PAGE,
-  [0xa7] = ADDR_MODE_NONE,
-  [0xa8] = ADDR_MODE_IMPLIED,
-  [0xa9] = ADDR_MODE_IMMEDIATE,
-  [0xaa] = ADDR_MODE_IMPLIED,
-  [0xab] = ADDR_MODE_NONE,
-  [0xac] = ADDR_MODE_ABSOLUTE,
-  [0xad] = ADDR_MODE_ABSOLUTE,
-  [0xae] = ADDR_MODE_ABSOLUTE,
-  [0xaf] = ADDR_MODE_NONE,
-
-  [0xb0] = ADDR_MODE_RELATIVE,
-  [0xb1] = ADDR_MODE_INDIRECT_Y,
-  [0xb2] = ADDR_MODE_NONE,
-  [0xb3] = ADDR_MODE_NONE,
-  [0xb4] = ADDR_MODE_ZERO_PAGE_X,
-  [0xb5] = ADDR_MODE_ZERO_PAGE_X,
-  [0xb6] = ADDR_MODE_ZERO_PAGE_Y,
-  [0xb7] = ADDR_MODE_NONE,
-  [0xb8] = ADDR_MODE_IMPLIED,
-  [0xb9] = ADDR_MODE_ABSOLUTE_Y,
-  [0xba] = ADDR_MODE_IMPLIED,
-  [0xbb] = ADDR_MODE_NONE,
-  [0xbc] = ADDR_MODE_ABSOLUTE_X,
-  [0xbd] = ADDR_MODE_ABSOLUTE_X,
-  [0xbe] = ADDR_MODE_ABSOLUTE_Y,
-  [0xbf] = ADDR_MODE_NONE,
-
-  [0xc0] = ADDR_MODE_IMMEDIATE,
-  [0xc1] = ADDR_MODE_INDIRECT_X,
-  [0xc2] = ADDR_MODE_NONE,
-  [0xc3] = ADDR_MODE_NONE,
-  [0xc4] = ADDR_MODE_ZERO_PAGE,
-  [0xc5] = ADDR_MODE_ZERO_PAGE,
-  [0xc6] = ADDR_MODE_ZERO_PAGE,
-  [0xc7] = ADDR_MODE_NONE,
-  [0xc8] = ADDR_MODE_IMPLIED,
-  [0xc9] = ADDR_MODE_IMMEDIATE,
-  [0xca] = ADDR_MODE_IMPLIED,
-  [0xcb] = ADDR_MODE_NONE,
-  [0xcc] = ADDR_MODE_ABSOLUTE,
-  [0xcd] = ADDR_MODE_ABSOLUTE,
-  [0xce] = ADDR_MODE_ABSOLUTE,
-  [0xcf] = ADDR_MODE_NONE,
-
-  [0xd0] = ADDR_MODE_RELATIVE,
-  [0xd1] = ADDR_MODE_INDIRECT_Y,
-  [0xd2] = ADDR_MODE_NONE,
-  [0xd3] = ADDR_MODE_NONE,
-  [0xd4] = ADDR_MODE_NONE,
-  [0xd5] = ADDR_MODE_ZERO_PAGE_X,
-  [0xd6] = ADDR_MODE_ZERO_PAGE_Y,
-  [0xd7] = ADDR_MODE_NONE,
-  [0xd8] = ADDR_MODE_IMPLIED,
-  [0xd9] = ADDR_MODE_ABSOLUTE_Y,
-  [0xda] = ADDR_MODE_NONE,
-  [0xdb] = ADDR_MODE_NONE,
-  [0xdc] = ADDR_MODE_NONE,
-  [0xdd] = ADDR_MODE_ABSOLUTE_X,
-  [0xde] = ADDR_MODE_ABSOLUTE_X,
-  [0xdf] = ADDR_MODE_NONE,
-
-  [0xe0] = ADDR_MODE_IMMEDIATE,
-  [0xe1] = ADDR_MODE_INDIRECT_X,
-  [0xe2] = ADDR_MODE_NONE,
-  [0xe3] = ADDR_MODE_NONE,
-  [0xe4] = ADDR_MODE_ZERO_PAGE,
-  [0xe5] = ADDR_MODE_ZERO_PAGE,
-  [0xe6] = ADDR_MODE_ZERO_PAGE,
-  [0xe7] = ADDR_MODE_NONE,
-  [0xe8] = ADDR_MODE_IMPLIED,
-  [0xe9] = ADDR_MODE_IMMEDIATE,
-  [0xea] = ADDR_MODE_IMPLIED,
-  [0xeb] = ADDR_MODE_NONE,
-  [0xec] = ADDR_MODE_ABSOLUTE,
-  [0xed] = ADDR_MODE_ABSOLUTE,
-  [0xee] = ADDR_MODE_ABSOLUTE,
-  [0xef] = ADDR_MODE_NONE,
-
-  [0xf0] = ADDR_MODE_RELATIVE,
-  [0xf1] = ADDR_MODE_INDIRECT_Y,
-  [0xf2] = ADDR_MODE_NONE,
-  [0xf3] = ADDR_MODE_NONE,
-  [0xf4] = ADDR_MODE_NONE,
-  [0xf5] = ADDR_MODE_ZERO_PAGE_X,
-  [0xf6] = ADDR_MODE_ZERO_PAGE_X,
-  [0xf7] = ADDR_MODE_NONE,
-  [0xf8] = ADDR_MODE_IMPLIED,
-  [0xf9] = ADDR_MODE_ABSOLUTE_Y,
-  [0xfa] = ADDR_MODE_NONE,
-  [0xfb] = ADDR_MODE_NONE,
-  [0xfc] = ADDR_MODE_NONE,
-  [0xfd] = ADDR_MODE_ABSOLUTE_X,
-  [0xfe] = ADDR_MODE_ABSOLUTE_X,
-  [0xff] = ADDR_MODE_NONE
+static const enum addressing_modes_6502 instruction_modes_6502[256] = {
+  CPU6502_OPCODES(CPU6502_MODE_ENTRY)
+};
+
+/* Instruction types for each instruction */
+static const enum instr_types_6502 instruction_types_6502[256] = {
+  CPU6502_OPCODES(CPU6502_TYPE_ENTRY)
 };
 
-static enum instr_types_6502 instruction_types_6502[256] = {
-  [0x00] = INSTR_TYPE_BRK,
-  [0x01] = INSTR_TYPE_ORA,
-  [0x02] = INSTR_TYPE_NONE,
-  [0x03] = INSTR_TYPE_NONE,
-  [0x04] = INSTR_TYPE_NONE,
-  [0x05] = INSTR_TYPE_ORA,
-  [0x06] = INSTR_TYPE_ASL,
-  [0x07] = INSTR_TYPE_NONE,
-  [0x08] = INSTR_TYPE_PHP,
-  [0x09] = INSTR_TYPE_ORA,
-  [0x0a] = INSTR_TYPE_ASL,
-  [0x0b] = INSTR_TYPE_NONE,
-  [0x0c] = INSTR_TYPE_NONE,
-  [0x0d] = INSTR_TYPE_ORA,
-  [0x0e] = INSTR_TYPE_ASL,
-  [0x0f] = INSTR_TYPE_NONE,
-
-  [0x10] = INSTR_TYPE_BPL,
-  [0x11] = INSTR_TYPE_ORA,
-  [0x12] = INSTR_TYPE_NONE,
-  [0x13] = INSTR_TYPE_NONE,
-  [0x14] = INSTR_TYPE_NONE,
-  [0x15] = INSTR_TYPE_ORA,
-  [0x16] = INSTR_TYPE_ASL,
-  [0x17] = INSTR_TYPE_NONE,
-  [0x18] = INSTR_TYPE_CLC,
-  [0x19] = INSTR_TYPE_ORA,
-  [0x1a] = INSTR_TYPE_NONE,
-  [0x1b] = INSTR_TYPE_NONE,
-  [0x1c] = INSTR_TYPE_NONE,
-  [0x1d] = INSTR_TYPE_ORA,
-  [0x1e] = INSTR_TYPE_ASL,
-  [0x1f] = INSTR_TYPE_NONE,
-
-  [0x20] = INSTR_TYPE_JSR,
-  [0x21] = INSTR_TYPE_AND,
-  [0x22] = INSTR_TYPE_NONE,
-  [0x23] = INSTR_TYPE_NONE,
-  [0x24] = INSTR_TYPE_BIT,
-  [0x25] = INSTR_TYPE_AND,
-  [0x26] = INSTR_TYPE_ROL,
-  [0x27] = INSTR_TYPE_NONE,
-  [0x28] = INSTR_TYPE_PLP,
-  [0x29] = INSTR_TYPE_AND,
-  [0x2a] = INSTR_TYPE_ROL,
-  [0x2b] = INSTR_TYPE_NONE,
-  [0x2c] = INSTR_TYPE_BIT,
-  [0x2d] = INSTR_TYPE_AND,
-  [0x2e] = INSTR_TYPE_ROL,
-  [0x2f] = INSTR_TYPE_NONE,
-
-  [0x30] = INSTR_TYPE_BMI,
-  [0x31] = INSTR_TYPE_AND,
-  [0x32] = INSTR_TYPE_NONE,
-  [0x33] = INSTR_TYPE_NONE,
-  [0x34] = INSTR_TYPE_NONE,
-  [0x35] = INSTR_TYPE_AND,
-  [0x36] = INSTR_TYPE_ROL,
-  [0x37] = INSTR_TYPE_NONE,
-  [0x38] = INSTR_TYPE_SEC,
-  [0x39] = INSTR_TYPE_AND,
-  [0x3a] = INSTR_TYPE_NONE,
-  [0x3b] = INSTR_TYPE_NONE,
-  [0x3c] = INSTR_TYPE_NONE,
-  [0x3d] = INSTR_TYPE_AND,
-  [0x3e] = INSTR_TYPE_ROL,
-  [0x3f] = INSTR_TYPE_NONE,
-
-  [0x40] = INSTR_TYPE_RTI,
-  [0x41] = INSTR_TYPE_EOR,
-  [0x42] = INSTR_TYPE_NONE,
-  [0x43] = INSTR_TYPE_NONE,
-  [0x44] = INSTR_TYPE_NONE,
-  [0x45] = INSTR_TYPE_EOR,
-  [0x46] = INSTR_TYPE_LSR,
-  [0x47] = INSTR_TYPE_NONE,
-  [0x48] = INSTR_TYPE_PHA,
-  [0x49] = INSTR_TYPE_EOR,
-  [0x4a] = INSTR_TYPE_LSR,
-  [0x4b] = INSTR_TYPE_NONE,
-  [0x4c] = INSTR_TYPE_JMP,
-  [0x4d] = INSTR_TYPE_EOR,
-  [0x4e] = INSTR_TYPE_LSR,
-  [0x4f] = INSTR_TYPE_NONE,
-
-  [0x50] = INSTR_TYPE_BVC,
-  [0x51] = INSTR_TYPE_EOR,
-  [0x52] = INSTR_TYPE_NONE,
-  [0x53] = INSTR_TYPE_NONE,
-  [0x54] = INSTR_TYPE_NONE,
-  [0x55] = INSTR_TYPE_EOR,
-  [0x56] = INSTR_TYPE_LSR,
-  [0x57] = INSTR_TYPE_NONE,
-  [0x58] = INSTR_TYPE_CLI,
-  [0x59] = INSTR_TYPE_EOR,
-  [0x5a] = INSTR_TYPE_NONE,
-  [0x5b] = INSTR_TYPE_NONE,
-  [0x5c] = INSTR_TYPE_NONE,
-  [0x5d] = INSTR_TYPE_EOR,
-  [0x5e] = INSTR_TYPE_LSR,
-  [0x5f] = INSTR_TYPE_NONE,
-
-  [0x60] = INSTR_TYPE_RTS,
-  [0x61] = INSTR_TYPE_ADC,
-  [0x62] = INSTR_TYPE_NONE,
-  [0x63] = INSTR_TYPE_NONE,
-  [0x64] = INSTR_TYPE_NONE,
-  [0x65] = INSTR_TYPE_ADC,
-  [0x66] = INSTR_TYPE_ROR,
-  [0x67] = INSTR_TYPE_NONE,
-  [0x68] = INSTR_TYPE_PLA,
-  [0x69] = INSTR_TYPE_ADC,
-  [0x6a] = INSTR_TYPE_ROR,
-  [0x6b] = INSTR_TYPE_NONE,
-  [0x6c] = INSTR_TYPE_JMP,
-  [0x6d] = INSTR_TYPE_ADC,
-  [0x6e] = INSTR_TYPE_ROR,
-  [0x6f] = INSTR_TYPE_NONE,
-  
-  [0x70] = INSTR_TYPE_BVS,
-  [0x71] = INSTR_TYPE_ADC,
-  [0x72] = INSTR_TYPE_NONE,
-  [0x73] = INSTR_TYPE_NONE,
-  [0x74] = INSTR_TYPE_NONE,
-  [0x75] = INSTR_TYPE_ADC,
-  [0x76] = INSTR_TYPE_ROR,
-  [0x77] = INSTR_TYPE_NONE,
-  [0x78] = INSTR_TYPE_SEI,
-  [0x79] = INSTR_TYPE_ADC,
-  [0x7a] = INSTR_TYPE_NONE,
-  [0x7b] = INSTR_TYPE_NONE,
-  [0x7c] = INSTR_TYPE_NONE,
-  [0x7d] = INSTR_TYPE_ADC,
-  [0x7e] = INSTR_TYPE_ROR,
-  [0x7f] = INSTR_TYPE_NONE,
-
-  [0x80] = INSTR_TYPE_NONE,
-  [0x81] = INSTR_TYPE_STA,
-  [0x82] = INSTR_TYPE_NONE,
-  [0x83] = INSTR_TYPE_NONE,
-  [0x84] = INSTR_TYPE_STY,
-  [0x85] = INSTR_TYPE_STA,
-  [0x86] = INSTR_TYPE_STX,
-  [0x87] = INSTR_TYPE_NONE,
-  [0x88] = INSTR_TYPE_DEY,
-  [0x89] = INSTR_TYPE_NONE,
-  [0x8a] = INSTR_TYPE_TXA,
-  [0x8b] = INSTR_TYPE_NONE,
-  [0x8c] = INSTR_TYPE_STY,
-  [0x8d] = INSTR_TYPE_STA,
-  [0x8e] = INSTR_TYPE_STX,
-  [0x8f] = INSTR_TYPE_NONE,
-
-  [0x90] = INSTR_TYPE_BCC,
-  [0x91] = INSTR_TYPE_STA,
-  [0x92] = INSTR_TYPE_NONE,
-  [0x93] = INSTR_TYPE_NONE,
-  [0x94] = INSTR_TYPE_STY,
-  [0x95] = INSTR_TYPE_STA,
-  [0x96] = INSTR_TYPE_STX,
-  [0x97] = INSTR_TYPE_NONE,
-  [0x98] = INSTR_TYPE_TYA,
-  [0x99] = INSTR_TYPE_STA,
-  [0x9a] = INSTR_TYPE_TXS,
-  [0x9b] = INSTR_TYPE_NONE,
-  [0x9c] = INSTR_TYPE_NONE,
-  [0x9d] = INSTR_TYPE_STA,
-  [0x9e] = INSTR_TYPE_NONE,
-  [0x9f] = INSTR_TYPE_NONE,
-
-  [0xa0] = INSTR_TYPE_LDY,
-  [0xa1] = INSTR_TYPE_LDA,
-  [0xa2] = INSTR_TYPE_LDX,
-  [0xa3] = INSTR_TYPE_NONE,
-  [0xa4] = INSTR_TYPE_LDY,
-  [0xa5] = INSTR_TYPE_LDA,
-  [0xa6] = INSTR_TYPE_LDX,
-  [0xa7] = INSTR_TYPE_NONE,
-  [0xa8] = INSTR_TYPE_TAY,
-  [0xa9] = INSTR_TYPE_LDA,
-  [0xaa] = INSTR_TYPE_TAX,
-  [0xab] = INSTR_TYPE_NONE,
-  [0xac] = INSTR_TYPE_LDY,
-  [0xad] = INSTR_TYPE_LDA,
-  [0xae] = INSTR_TYPE_LDX,
-  [0xaf] = INSTR_TYPE_NONE,
-
-  [0xb0] = INSTR_TYPE_BCS,
-  [0xb1] = INSTR_TYPE_LDA,
-  [0xb2] = INSTR_TYPE_NONE,
-  [0xb3] = INSTR_TYPE_NONE,
-  [0xb4] = INSTR_TYPE_LDY,
-  [0xb5] = INSTR_TYPE_LDA,
-  [0xb6] = INSTR_TYPE_LDX,
-  [0xb7] = INSTR_TYPE_NONE,
-  [0xb8] = INSTR_TYPE_CLV,
-  [0xb9] = INSTR_TYPE_LDA,
-  [0xba] = INSTR_TYPE_TSX,
-  [0xbb] = INSTR_TYPE_NONE,
-  [0xbc] = INSTR_TYPE_LDY,
-  [0xbd] = INSTR_TYPE_LDA,
-  [0xbe] = INSTR_TYPE_LDX,
-  [0xbf] = INSTR_TYPE_NONE,
-
-  [0xc0] = INSTR_TYPE_CPY,
-  [0xc1] = INSTR_TYPE_CMP,
-  [0xc2] = INSTR_TYPE_NONE,
-  [0xc3] = INSTR_TYPE_NONE,
-  [0xc4] = INSTR_TYPE_CPY,
-  [0xc5] = INSTR_TYPE_CMP,
-  [0xc6] = INSTR_TYPE_DEC,
-  [0xc7] = INSTR_TYPE_NONE,
-  [0xc8] = INSTR_TYPE_INY,
-  [0xc9] = INSTR_TYPE_CMP,
-  [0xca] = INSTR_TYPE_DEX,
-  [0xcb] = INSTR_TYPE_NONE,
-  [0xcc] = INSTR_TYPE_CPY,
-  [0xcd] = INSTR_TYPE_CMP,
-  [0xce] = INSTR_TYPE_DEC,
-  [0xcf] = INSTR_TYPE_NONE,
-
-  [0xd0] = INSTR_TYPE_BNE,
-  [0xd1] = INSTR_TYPE_CMP,
-  [0xd2] = INSTR_TYPE_NONE,
-  [0xd3] = INSTR_TYPE_NONE,
-  [0xd4] = INSTR_TYPE_NONE,
-  [0xd5] = INSTR_TYPE_CMP,
-  [0xd6] = INSTR_TYPE_DEC,
-  [0xd7] = INSTR_TYPE_NONE,
-  [0xd8] = INSTR_TYPE_CLD,
-  [0xd9] = INSTR_TYPE_CMP,
-  [0xda] = INSTR_TYPE_NONE,
-  [0xdb] = INSTR_TYPE_NONE,
-  [0xdc] = INSTR_TYPE_NONE,
-  [0xdd] = INSTR_TYPE_CMP,
-  [0xde] = INSTR_TYPE_DEC,
-  [0xdf] = INSTR_TYPE_NONE,
-
-  [0xe0] = INSTR_TYPE_CPX,
-  [0xe1] = INSTR_TYPE_SBC,
-  [0xe2] = INSTR_TYPE_NONE,
-  [0xe3] = INSTR_TYPE_NONE,
-  [0xe4] = INSTR_TYPE_CPX,
-  [0xe5] = INSTR_TYPE_SBC,
-  [0xe6] = INSTR_TYPE_INC,
-  [0xe7] = INSTR_TYPE_NONE,
-  [0xe8] = INSTR_TYPE_INX,
-  [0xe9] = INSTR_TYPE_SBC,
-  [0xea] = INSTR_TYPE_NOP,
-  [0xeb] = INSTR_TYPE_NONE,
-  [0xec] = INSTR_TYPE_CPX,
-  [0xed] = INSTR_TYPE_SBC,
-  [0xee] = INSTR_TYPE_INC,
-  [0xef] = INSTR_TYPE_NONE,
-
-  [0xf0] = INSTR_TYPE_BEQ,
-  [0xf1] = INSTR_TYPE_SBC,
-  [0xf2] = INSTR_TYPE_NONE,
-  [0xf3] = INSTR_TYPE_NONE,
-  [0xf4] = INSTR_TYPE_NONE,
-  [0xf5] = INSTR_TYPE_SBC,
-  [0xf6] = INSTR_TYPE_INC,
-  [0xf7] = INSTR_TYPE_NONE,
-  [0xf8] = INSTR_TYPE_SED,
-  [0xf9] = INSTR_TYPE_SBC,
-  [0xfa] = INSTR_TYPE_NONE,
-  [0xfb] = INSTR_TYPE_NONE,
-  [0xfc] = INSTR_TYPE_NONE,
-  [0xfd] = INSTR_TYPE_SBC,
-  [0xfe] = INSTR_TYPE_INC,
-  [0xff] = INSTR_TYPE_NONE
+/* Base cycles for each instruction */
+static const uint8_t instruction_cycles_6502[256] = {
+  CPU6502_OPCODES(CPU6502_CYCLES_ENTRY)
 };
 
-/* Reset the 6502 CPU */
+/* Status flags each instruction may change */
+static const uint8_t instruction_flags_6502[256] = {
+  CPU6502_OPCODES(CPU6502_FLAGS_ENTRY)
+};
+
+/* Mnemonic of each instruction */
+static const char *const instruction_names_6502[256] = {
+  CPU6502_OPCODES(CPU6502_NAME_ENTRY)
+};
+
+/* Length of an instruction in each addressing mode, in bytes */
+static const uint8_t mode_lengths_6502[] = {
+  [ADDR_MODE_ACCUMULATOR] = 1,
+  [ADDR_MODE_ABSOLUTE] = 3,
+  [ADDR_MODE_ABSOLUTE_X] = 3,
+  [ADDR_MODE_ABSOLUTE_Y] = 3,
+  [ADDR_MODE_IMMEDIATE] = 2,
+  [ADDR_MODE_IMPLIED] = 1,
+  [ADDR_MODE_INDIRECT] = 3,
+  [ADDR_MODE_INDIRECT_X] = 2,
+  [ADDR_MODE_INDIRECT_Y] = 2,
+  [ADDR_MODE_RELATIVE] = 2,
+  [ADDR_MODE_ZERO_PAGE] = 2,
+  [ADDR_MODE_ZERO_PAGE_X] = 2,
+  [ADDR_MODE_ZERO_PAGE_Y] = 2,
+  [ADDR_MODE_NONE] = 1,
+};
+
+/* Disassembly format of each addressing mode, given the mnemonic */
+static const char *const mode_formats_6502[] = {
+  [ADDR_MODE_ACCUMULATOR] = "%s A",
+  [ADDR_MODE_ABSOLUTE] = "%s $%04X",
+  [ADDR_MODE_ABSOLUTE_X] = "%s $%04X,X",
+  [ADDR_MODE_ABSOLUTE_Y] = "%s $%04X,Y",
+  [ADDR_MODE_IMMEDIATE] = "%s #$%02X",
+  [ADDR_MODE_IMPLIED] = "%s",
+  [ADDR_MODE_INDIRECT] = "%s ($%04X)",
+  [ADDR_MODE_INDIRECT_X] = "%s ($%02X,X)",
+  [ADDR_MODE_INDIRECT_Y] = "%s ($%02X),Y",
+  [ADDR_MODE_RELATIVE] = "%s $%04X",
+  [ADDR_MODE_ZERO_PAGE] = "%s $%02X",
+  [ADDR_MODE_ZERO_PAGE_X] = "%s $%02X,X",
+  [ADDR_MODE_ZERO_PAGE_Y] = "%s $%02X,Y",
+  [ADDR_MODE_NONE] = ".byte $%02X",
+};
+
+/* Get the superinstruction a pair of opcodes makes, if any */
+static enum fused_pairs_6502 cpu6502_fused_pair(uint8_t first, uint8_t second) {
+  enum instr_types_6502 a = instruction_types_6502[first];
+  enum instr_types_6502 b = instruction_types_6502[second];
+  if ((a == INSTR_TYPE_CMP || a == INSTR_TYPE_CPX || a == INSTR_TYPE_CPY) &&
+      (b == INSTR_TYPE_BNE || b == INSTR_TYPE_BEQ))
+    return FUSED_PAIR_COMPARE_BRANCH;
+  if (a == INSTR_TYPE_LDA && b == INSTR_TYPE_STA)
+    return FUSED_PAIR_LOAD_STORE;
+  if ((a == INSTR_TYPE_DEX || a == INSTR_TYPE_DEY) && b == INSTR_TYPE_BNE)
+    return FUSED_PAIR_COUNT_BRANCH;
+  if (a == INSTR_TYPE_CLC && b == INSTR_TYPE_ADC)
+    return FUSED_PAIR_CLEAR_ADD;
+  return FUSED_PAIR_NONE;
+}
+
+/* Read a byte of RAM, by its offset in RAM */
+static uint8_t cpu6502_ram_read(const struct cpu6502 *cpu, size_t offset) {
+  return cpu->read_blocks[offset / BLOCK_SIZE][offset % BLOCK_SIZE];
+}
+/* Allocate a block of RAM holding the power-on pattern (NULL on failure) */
+static uint8_t *cpu6502_alloc_block(struct cpu6502 *cpu, size_t block) {
+  uint8_t *data = cpu->blocks[block];
+  if (data) return data;
+  data = malloc(BLOCK_SIZE);
+  if (!data) return NULL;
+  memcpy(data, cpu->fill_block, BLOCK_SIZE);
+  cpu->blocks[block] = data;
+  cpu->read_blocks[block] = data;
+  return data;
+}
+/* Free a block of RAM, so it reads as the power-on pattern again */
+static void cpu6502_free_block(struct cpu6502 *cpu, size_t block) {
+  free(cpu->blocks[block]);
+  cpu->blocks[block] = NULL;
+  cpu->read_blocks[block] = cpu->fill_block;
+  cpu->dirty[block] = 0;
+  cpu->written[block] = 0;
+}
+/* Count the bytes of RAM allocated to a machine */
+static size_t cpu6502_ram_allocated(const struct cpu6502 *cpu) {
+  size_t block, size = 0;
+  for (block = 0; block < BLOCK_COUNT; block++)
+    if (cpu->blocks[block]) size += BLOCK_SIZE;
+  return size;
+}
+/* Read a byte from memory, without taking any cycles */
+static uint8_t cpu6502_peek(struct cpu6502 *cpu, uint16_t addr) {
+  return cpu6502_ram_read(cpu, cpu->page_map[addr / PAGE_SIZE] + addr % PAGE_SIZE);
+}
+/* Read a byte from memory */
+static uint8_t cpu6502_read(struct cpu6502 *cpu, uint16_t addr) {
+  /* Always added, so pages without wait states cost no branch */
+  cpu->cycles_behind += cpu->wait_states[addr / PAGE_SIZE];
+  cpu->io_activity += cpu->page_flags[addr / PAGE_SIZE] & PAGE_FLAG_IO;
+  if ((cpu->page_flags[addr / PAGE_SIZE] & PAGE_FLAG_IO) && cpu->hooks.io_read)
+    return cpu->hooks.io_read(cpu, addr, cpu->hooks.io_ctx);
+  return cpu6502_ram_read(cpu, cpu->page_map[addr / PAGE_SIZE] + addr % PAGE_SIZE);
+}
+/* Map a bank into its window if addr is its select register */
+static int cpu6502_select_bank(struct cpu6502 *cpu, uint16_t addr, uint8_t value) {
+  const struct cpu6502_bank *bank;
+  size_t i, page;
+  uint32_t offset;
+  for (i = 0; i < cpu->bank_count; i++) {
+    bank = &cpu->banks[i];
+    if (bank->reg != addr) continue;
+    offset = bank->base + (value % bank->count) * bank->size;
+    for (page = 0; page < bank->size / PAGE_SIZE; page++)
+      cpu->page_map[bank->window / PAGE_SIZE + page] = offset + page * PAGE_SIZE;
+    return 1;
+  }
+  return 0;
+}
+/* Write a byte to memory, marking its page of RAM as dirty */
+static void cpu6502_write(struct cpu6502 *cpu, uint16_t addr, uint8_t value) {
+  size_t page = addr / PAGE_SIZE, offset;
+  uint8_t *data;
+  cpu->cycles_behind += cpu->wait_states[page];
+  /* Ordinary RAM pages, traced or not, take only this branch */
+  if (cpu->page_flags[page] & PAGE_FLAGS_WRITE) {
+    cpu->io_activity += cpu->page_flags[page] & PAGE_FLAG_IO;
+    if ((cpu->page_flags[page] & PAGE_FLAG_BANK) &&
+        cpu6502_select_bank(cpu, addr, value))
+      return;
+    if (cpu->page_flags[page] & PAGE_FLAG_ROM) return;
+    if ((cpu->page_flags[page] & PAGE_FLAG_LOG) && cpu->hooks.write)
+      cpu->hooks.write(cpu, addr, value, cpu->hooks.write_ctx);
+    if ((cpu->page_flags[page] & PAGE_FLAG_IO) && cpu->hooks.io_write &&
+        cpu->hooks.io_write(cpu, addr, value, cpu->hooks.io_ctx))
+      return;
+  }
+  offset = cpu->page_map[page] + addr % PAGE_SIZE;
+  data = cpu->blocks[offset / BLOCK_SIZE];
+  /* The first write to a block allocates it (the write is lost if that fails) */
+  if (!data && !(data = cpu6502_alloc_block(cpu, offset / BLOCK_SIZE))) return;
+  data[offset % BLOCK_SIZE] = value;
+  cpu->dirty[offset / BLOCK_SIZE] |= (uint64_t)1 << ((offset / PAGE_SIZE) % 64);
+  cpu->written[offset / BLOCK_SIZE] |= (uint64_t)1 << ((offset / PAGE_SIZE) % 64);
+}
+/* Move the PC somewhere other than the next instruction */
+static void cpu6502_branch(
+    struct cpu6502 *cpu,
+    enum branch_kinds_6502 kind,
+    uint16_t to) {
+  /* Code on untraced pages pays only for the flag test */
+  if (((cpu->page_flags[cpu->pc / PAGE_SIZE] | cpu->page_flags[to / PAGE_SIZE]) &
+        PAGE_FLAG_TRACE) && cpu->hooks.branch)
+    cpu->hooks.branch(cpu, kind, cpu->pc, to, cpu->hooks.branch_ctx);
+  cpu->pc = to;
+}
+/* Reset the 6502 CPU (warm reset: registers only, RAM is left alone) */
 static void cpu6502_reset(struct cpu6502 *cpu) {
   /* Resetting takes 6 cycles, according to wikipedia */
   cpu->cycles_behind = 6;
-  /* The size of the RAM */
-  cpu->ram_size = RAM_SIZE;
   /* Chip state guaranteed */
   /* --- THIS SEEMS TO BE WHAT CHIPS ALWAYS DO --- */
   cpu->flags.i = 1; /* Set interrupt disable */
   cpu->flags.d = 0; /* Clear decimal (this isn't guaranteed on every 6502) */
-  /* The program counter set to the value at 0xfffc-0xfffd (the reset vector) */
-  cpu->pc = cpu->ram[RESET_VECTOR] | (cpu->ram[RESET_VECTOR+1] << 8);
   /* --- I MIGHT AS WELL ALSO DO THIS --- */
   cpu->flags.z = 1; /* Set zero */
   cpu->flags.n = 0; /* Clear negative */
@@ -708,12 +414,957 @@ static void cpu6502_reset(struct cpu6502 *cpu) {
   cpu->a = 0;       /* Clear accumulator */
   cpu->x = 0;       /* Clear index register X */
   cpu->y = 0;       /* Clear index register Y */
+  cpu->nmi_pending = 0; /* Forget any NMI edge */
+  /* The program counter set to the value at 0xfffc-0xfffd (the reset vector) */
+  /* (last, so a branch hook sees the rest of the reset done) */
+  cpu6502_branch(cpu, BRANCH_KIND_INTERRUPT,
+      cpu6502_peek(cpu, RESET_VECTOR) | (cpu6502_peek(cpu, RESET_VECTOR+1) << 8));
+}
+/* Fill part of a page of allocated RAM with the power-on pattern */
+static void cpu6502_fill(struct cpu6502 *cpu, size_t offset, size_t size) {
+  /* The pattern block has the same phase as every block */
+  memcpy(cpu->blocks[offset / BLOCK_SIZE] + offset % BLOCK_SIZE,
+      cpu->fill_block + offset % BLOCK_SIZE, size);
+}
+/* Copy data into RAM at an offset, without marking it dirty (0 on success) */
+static int cpu6502_store(
+    struct cpu6502 *cpu,
+    size_t offset,
+    const uint8_t *data,
+    size_t size) {
+  uint8_t *block;
+  size_t n;
+  while (size > 0) {
+    n = BLOCK_SIZE - offset % BLOCK_SIZE;
+    if (n > size) n = size;
+    block = cpu6502_alloc_block(cpu, offset / BLOCK_SIZE);
+    if (!block) return -1;
+    memcpy(block + offset % BLOCK_SIZE, data, n);
+    offset += n;
+    data += n;
+    size -= n;
+  }
+  return 0;
+}
+/* Power on everything but RAM: the address space, the hooks and the CPU */
+static void cpu6502_power_on_registers(struct cpu6502 *cpu) {
+  size_t i;
+  memset(cpu->wait_states, 0, sizeof(cpu->wait_states));
+  /* The address space is mapped straight onto the start of RAM */
+  for (i = 0; i < ADDR_PAGE_COUNT; i++)
+    cpu->page_map[i] = (uint32_t)(i * PAGE_SIZE);
+  memset(cpu->page_flags, 0, sizeof(cpu->page_flags));
+  cpu->bank_count = 0;
+  memset(&cpu->hooks, 0, sizeof(cpu->hooks));
+  cpu->hooks.due_cycle = UINT64_MAX;
+  cpu->cycles = 0;
+  cpu->irq_line = 0;
+  cpu->io_activity = 0;
+  cpu6502_reset(cpu);
+}
+/* Power on the 6502 CPU (cold start: RAM is filled with a repeating pattern) */
+static void cpu6502_power_on(struct cpu6502 *cpu, uint64_t pattern) {
+  size_t i;
+  /* The size of the RAM */
+  cpu->ram_size = RAM_SIZE;
+  /* The pattern repeats every 8 bytes, lowest byte first */
+  for (i = 0; i < BLOCK_SIZE; i++)
+    cpu->fill_block[i] = (uint8_t)(pattern >> (8 * (i % 8)));
+  /* Freeing every block makes all of RAM read as the pattern */
+  for (i = 0; i < BLOCK_COUNT; i++)
+    cpu6502_free_block(cpu, i);
+  cpu6502_power_on_registers(cpu);
+}
+/* Set up a machine with no RAM allocated, and power it on */
+static void cpu6502_init(struct cpu6502 *cpu) {
+  size_t i;
+  for (i = 0; i < BLOCK_COUNT; i++)
+    cpu->blocks[i] = NULL;
+  cpu6502_power_on(cpu, 0);
+}
+/* Free a machine's RAM */
+static void cpu6502_free(struct cpu6502 *cpu) {
+  size_t i;
+  for (i = 0; i < BLOCK_COUNT; i++)
+    cpu6502_free_block(cpu, i);
+}
+/* Load an image at the start of RAM, freeing the rest (0 on success) */
+static int cpu6502_load(struct cpu6502 *cpu, const uint8_t *image, size_t size) {
+  size_t i;
+  if (size > RAM_SIZE) size = RAM_SIZE;
+  for (i = 0; i < BLOCK_COUNT; i++)
+    cpu6502_free_block(cpu, i);
+  return cpu6502_store(cpu, 0, image, size);
+}
+/* Restore only the dirty pages of RAM to an initial image, returning how many */
+static size_t cpu6502_restore(struct cpu6502 *cpu, const uint8_t *image, size_t size) {
+  size_t word, bit, page, offset, n, restored = 0;
+  if (size > RAM_SIZE) size = RAM_SIZE;
+  for (word = 0; word < BLOCK_COUNT; word++) {
+    /* Skip 64 clean pages at a time */
+    if (!cpu->dirty[word]) continue;
+    for (bit = 0; bit < 64; bit++) {
+      if (!(cpu->dirty[word] & ((uint64_t)1 << bit))) continue;
+      page = word * 64 + bit;
+      offset = page * PAGE_SIZE;
+      /* The part of the page covered by the image */
+      n = offset < size ? size - offset : 0;
+      if (n > PAGE_SIZE) n = PAGE_SIZE;
+      memcpy(cpu->blocks[word] + offset % BLOCK_SIZE, image + offset, n);
+      /* The part past the end of the image gets the power-on pattern */
+      cpu6502_fill(cpu, offset + n, PAGE_SIZE - n);
+      restored++;
+    }
+    /* Restoring changes them too, as far as a copy is concerned */
+    cpu->written[word] |= cpu->dirty[word];
+    cpu->dirty[word] = 0;
+  }
+  return restored;
+}
+/* Copy everything but RAM from one machine to another */
+static void cpu6502_copy_registers(struct cpu6502 *dst, const struct cpu6502 *src) {
+  const size_t head = offsetof(struct cpu6502, blocks);
+  const size_t tail = offsetof(struct cpu6502, read_blocks) + sizeof(src->read_blocks);
+  struct cpu6502_hooks hooks = dst->hooks;
+  memcpy(dst, src, head);
+  memcpy((uint8_t *)dst + tail, (const uint8_t *)src + tail,
+      sizeof(struct cpu6502) - tail);
+  dst->hooks = hooks;
+}
+/* Copy a machine into another, block by allocated block (0 on success) */
+static int cpu6502_clone(struct cpu6502 *dst, const struct cpu6502 *src) {
+  size_t block;
+  cpu6502_copy_registers(dst, src);
+  /* Unallocated blocks stay unallocated, and read as the copied pattern */
+  for (block = 0; block < BLOCK_COUNT; block++) {
+    if (!src->blocks[block]) {
+      free(dst->blocks[block]);
+      dst->blocks[block] = NULL;
+      dst->read_blocks[block] = dst->fill_block;
+    } else if (cpu6502_alloc_block(dst, block)) {
+      memcpy(dst->blocks[block], src->blocks[block], BLOCK_SIZE);
+    } else {
+      return -1;
+    }
+  }
+  return 0;
+}
+/* Copy a machine into another it last matched (0 on success) */
+/* Machines last match when loaded from the same image, cloned or copied */
+/* Only pages written in either since are copied, then both start afresh */
+/* On failure the destination is left as it was */
+static int cpu6502_copy(struct cpu6502 *dst, struct cpu6502 *src) {
+  size_t word, bit, offset;
+  uint64_t pages;
+  /* Allocate first, so running out of memory changes nothing */
+  /* (a newly allocated block holds the pattern it read as before) */
+  for (word = 0; word < BLOCK_COUNT; word++)
+    if ((dst->written[word] | src->written[word]) && src->blocks[word] &&
+        !cpu6502_alloc_block(dst, word))
+      return -1;
+  /* Pages written in neither still match */
+  for (word = 0; word < BLOCK_COUNT; word++) {
+    pages = dst->written[word] | src->written[word];
+    if (!pages) continue;
+    /* A block the source never allocated holds only the pattern */
+    if (!src->blocks[word]) {
+      cpu6502_free_block(dst, word);
+      continue;
+    }
+    for (bit = 0; bit < 64; bit++) {
+      if (!(pages & ((uint64_t)1 << bit))) continue;
+      offset = bit * PAGE_SIZE;
+      memcpy(dst->blocks[word] + offset, src->blocks[word] + offset, PAGE_SIZE);
+    }
+  }
+  /* Everything else, including the dirty pages */
+  cpu6502_copy_registers(dst, src);
+  /* The two match now, so the next copy need only look at later writes */
+  memset(dst->written, 0, sizeof(dst->written));
+  memset(src->written, 0, sizeof(src->written));
+  return 0;
+}
+/* Check whether a relative branch opcode would be taken now */
+static int cpu6502_branch_taken(const struct cpu6502 *cpu, uint8_t opcode) {
+  switch (instruction_types_6502[opcode]) {
+    case INSTR_TYPE_BCC: return !cpu->flags.c;
+    case INSTR_TYPE_BCS: return cpu->flags.c;
+    case INSTR_TYPE_BEQ: return cpu->flags.z;
+    case INSTR_TYPE_BMI: return cpu->flags.n;
+    case INSTR_TYPE_BNE: return !cpu->flags.z;
+    case INSTR_TYPE_BPL: return !cpu->flags.n;
+    case INSTR_TYPE_BVC: return !cpu->flags.v;
+    case INSTR_TYPE_BVS: return cpu->flags.v;
+    default: return 0;
+  }
+}
+/* Check whether the CPU is spinning on a jump or branch to itself */
+static int cpu6502_idle(struct cpu6502 *cpu) {
+  uint8_t opcode;
+  /* Only between instructions, with no interrupt about to be taken */
+  if (cpu->cycles_behind > 0) return 0;
+  if (cpu->nmi_pending || (cpu->irq_line && !cpu->flags.i)) return 0;
+  /* Nor with anything due, such as a device that could interrupt it */
+  if (cpu->hooks.due_cycle != UINT64_MAX) return 0;
+  opcode = cpu6502_peek(cpu, cpu->pc);
+  /* JMP to its own address */
+  if (opcode == 0x4c)
+    return (cpu6502_peek(cpu, (uint16_t)(cpu->pc + 1)) |
+        (cpu6502_peek(cpu, (uint16_t)(cpu->pc + 2)) << 8)) == cpu->pc;
+  /* Taken branch back by its own length (nothing can change the flags) */
+  if (instruction_modes_6502[opcode] == ADDR_MODE_RELATIVE)
+    return cpu6502_peek(cpu, (uint16_t)(cpu->pc + 1)) == 0xfe &&
+      cpu6502_branch_taken(cpu, opcode);
+  return 0;
+}
+/* Set the wait states of every page in an address range */
+static void cpu6502_set_wait_states(
+    struct cpu6502 *cpu,
+    uint16_t start,
+    uint16_t end,
+    uint8_t cycles) {
+  size_t page;
+  for (page = start / PAGE_SIZE; page <= end / PAGE_SIZE; page++)
+    cpu->wait_states[page] = cycles;
+}
+/* Signal an NMI (edge triggered, taken before the next instruction) */
+static void cpu6502_nmi(struct cpu6502 *cpu) {
+  cpu->nmi_pending = 1;
+}
+/* Assert or release the IRQ line (level triggered, masked by the I flag) */
+static void cpu6502_irq(struct cpu6502 *cpu, int asserted) {
+  cpu->irq_line = asserted ? 1 : 0;
+}
+/* Push a byte onto the stack */
+static void cpu6502_push(struct cpu6502 *cpu, uint8_t value) {
+  cpu6502_write(cpu, 0x0100 | cpu->sp, value);
+  cpu->sp--;
+}
+/* Take an interrupt through a vector, which takes 7 cycles */
+static CPU6502_COLD void cpu6502_interrupt(
+    struct cpu6502 *cpu,
+    uint16_t vector) {
+  /* Interrupts come from outside, so they count as I/O */
+  cpu->io_activity++;
+  cpu6502_push(cpu, cpu->pc >> 8);
+  cpu6502_push(cpu, cpu->pc & 0xff);
+  /* Pushed with the break flag clear and the unused flag set */
+  cpu6502_push(cpu, (uint8_t)((cpu->status | 0x20) & ~0x10));
+  cpu->flags.i = 1;
+  /* On top of any wait states of the pushes and vector reads */
+  cpu->cycles_behind += 7;
+  cpu6502_branch(cpu, BRANCH_KIND_INTERRUPT,
+      cpu6502_read(cpu, vector) | (cpu6502_read(cpu, vector + 1) << 8));
+}
+/*
+ * The interpreter.
+ * Each opcode gets its own handler, generated from the opcode list, which
+ * runs its instruction type's function with the addressing mode as a
+ * constant. Those functions and the addressing helpers are inline, so
+ * each handler is specialized down to its one mode. A handler of an
+ * instruction that can start a superinstruction also runs the next one,
+ * in the same step, if the two fuse (see cpu6502_fused_pair).
+ */
+/* Handler of an opcode, called with the PC on the opcode */
+typedef void (*cpu6502_handler_fn)(struct cpu6502 *cpu);
+
+/* Read a little-endian word */
+static inline uint16_t cpu6502_read_word(struct cpu6502 *cpu, uint16_t addr) {
+  return (uint16_t)(cpu6502_read(cpu, addr) |
+      (cpu6502_read(cpu, (uint16_t)(addr + 1)) << 8));
+}
+/* Read a little-endian word from zero page, wrapping within it */
+static inline uint16_t cpu6502_read_zero_page_word(
+    struct cpu6502 *cpu,
+    uint8_t addr) {
+  return (uint16_t)(cpu6502_read(cpu, addr) |
+      (cpu6502_read(cpu, (uint8_t)(addr + 1)) << 8));
+}
+/* Pop a byte off the stack */
+static inline uint8_t cpu6502_pop(struct cpu6502 *cpu) {
+  cpu->sp++;
+  return cpu6502_read(cpu, 0x0100 | cpu->sp);
+}
+/* Move the PC past the current instruction */
+static inline void cpu6502_next(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->pc = (uint16_t)(cpu->pc + mode_lengths_6502[mode]);
+}
+/* Set the negative and zero flags from a result */
+static inline void cpu6502_set_nz(struct cpu6502 *cpu, uint8_t value) {
+  cpu->flags.z = value == 0;
+  cpu->flags.n = value >> 7;
+}
+/* Get the address the current instruction operates on */
+/* Indexing across a page costs a cycle if crossing is set (reads only) */
+static inline uint16_t cpu6502_address(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode,
+    int crossing) {
+  uint16_t operand = (uint16_t)(cpu->pc + 1), base, addr;
+  switch (mode) {
+  case ADDR_MODE_IMMEDIATE:
+    return operand;
+  case ADDR_MODE_ZERO_PAGE:
+    return cpu6502_read(cpu, operand);
+  case ADDR_MODE_ZERO_PAGE_X:
+    return (uint8_t)(cpu6502_read(cpu, operand) + cpu->x);
+  case ADDR_MODE_ZERO_PAGE_Y:
+    return (uint8_t)(cpu6502_read(cpu, operand) + cpu->y);
+  case ADDR_MODE_ABSOLUTE:
+    return cpu6502_read_word(cpu, operand);
+  case ADDR_MODE_ABSOLUTE_X:
+    base = cpu6502_read_word(cpu, operand);
+    addr = (uint16_t)(base + cpu->x);
+    break;
+  case ADDR_MODE_ABSOLUTE_Y:
+    base = cpu6502_read_word(cpu, operand);
+    addr = (uint16_t)(base + cpu->y);
+    break;
+  case ADDR_MODE_INDIRECT:
+    /* The pointer's high byte never comes from the next page (NMOS bug) */
+    base = cpu6502_read_word(cpu, operand);
+    return (uint16_t)(cpu6502_read(cpu, base) |
+        (cpu6502_read(cpu, (base & 0xff00) | ((base + 1) & 0xff)) << 8));
+  case ADDR_MODE_INDIRECT_X:
+    return cpu6502_read_zero_page_word(cpu,
+        (uint8_t)(cpu6502_read(cpu, operand) + cpu->x));
+  case ADDR_MODE_INDIRECT_Y:
+    base = cpu6502_read_zero_page_word(cpu, cpu6502_read(cpu, operand));
+    addr = (uint16_t)(base + cpu->y);
+    break;
+  default:
+    return 0;
+  }
+  if (crossing && ((base ^ addr) & 0xff00)) cpu->cycles_behind++;
+  return addr;
+}
+/* Read the value the current instruction operates on */
+static inline uint8_t cpu6502_operand(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  if (mode == ADDR_MODE_ACCUMULATOR) return cpu->a;
+  return cpu6502_read(cpu, cpu6502_address(cpu, mode, 1));
+}
+/* Write the result of a read-modify-write instruction back */
+static inline void cpu6502_write_back(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode,
+    uint16_t addr,
+    uint8_t value) {
+  if (mode == ADDR_MODE_ACCUMULATOR) cpu->a = value;
+  else cpu6502_write(cpu, addr, value);
+  cpu6502_set_nz(cpu, value);
+  cpu6502_next(cpu, mode);
+}
+/* Take a relative branch if a condition holds */
+static inline void cpu6502_relative(struct cpu6502 *cpu, int taken) {
+  uint16_t next = (uint16_t)(cpu->pc + 2), to;
+  if (!taken) {
+    cpu->pc = next;
+    return;
+  }
+  to = (uint16_t)(next + (int8_t)cpu6502_read(cpu, (uint16_t)(cpu->pc + 1)));
+  /* A taken branch costs a cycle, and another if it crosses a page */
+  cpu->cycles_behind += (next ^ to) & 0xff00 ? 2 : 1;
+  cpu6502_branch(cpu, BRANCH_KIND_BRANCH, to);
+}
+/* Compare a register with the operand */
+static inline void cpu6502_compare(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode,
+    uint8_t reg) {
+  uint8_t value = cpu6502_operand(cpu, mode);
+  cpu->flags.c = reg >= value;
+  cpu6502_set_nz(cpu, (uint8_t)(reg - value));
+  cpu6502_next(cpu, mode);
+}
+/* Add in binary */
+static inline void cpu6502_add(struct cpu6502 *cpu, uint8_t value) {
+  unsigned sum = cpu->a + value + cpu->flags.c;
+  cpu->flags.v = ((~(cpu->a ^ value) & (cpu->a ^ sum)) >> 7) & 1;
+  cpu->flags.c = sum > 0xff;
+  cpu->a = (uint8_t)sum;
+  cpu6502_set_nz(cpu, cpu->a);
+}
+/* Add in decimal, with the NMOS flags (N, V and Z as in binary) */
+static CPU6502_COLD void cpu6502_add_decimal(
+    struct cpu6502 *cpu,
+    uint8_t value) {
+  unsigned lo = (cpu->a & 0x0f) + (value & 0x0f) + cpu->flags.c, hi;
+  if (lo > 9) lo += 6;
+  hi = (cpu->a >> 4) + (value >> 4) + (lo > 0x0f);
+  cpu->flags.z = ((cpu->a + value + cpu->flags.c) & 0xff) == 0;
+  cpu->flags.n = (hi >> 3) & 1;
+  cpu->flags.v = ((~(cpu->a ^ value) & (cpu->a ^ (hi << 4))) >> 7) & 1;
+  if (hi > 9) hi += 6;
+  cpu->flags.c = hi > 0x0f;
+  cpu->a = (uint8_t)((hi << 4) | (lo & 0x0f));
+}
+/* Subtract in decimal, with the NMOS flags (all as in binary) */
+static CPU6502_COLD void cpu6502_subtract_decimal(
+    struct cpu6502 *cpu,
+    uint8_t value) {
+  int lo = (cpu->a & 0x0f) - (value & 0x0f) - !cpu->flags.c;
+  int hi = (cpu->a >> 4) - (value >> 4);
+  if (lo < 0) {
+    lo -= 6;
+    hi--;
+  }
+  if (hi < 0) hi -= 6;
+  cpu6502_add(cpu, (uint8_t)~value);
+  /* Unsigned, as hi can be negative */
+  cpu->a = (uint8_t)(((unsigned)hi << 4) | (lo & 0x0f));
+}
+
+/* Load/store */
+static inline void cpu6502_exec_LDA(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->a = cpu6502_operand(cpu, mode);
+  cpu6502_set_nz(cpu, cpu->a);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_LDX(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->x = cpu6502_operand(cpu, mode);
+  cpu6502_set_nz(cpu, cpu->x);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_LDY(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->y = cpu6502_operand(cpu, mode);
+  cpu6502_set_nz(cpu, cpu->y);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_STA(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu6502_write(cpu, cpu6502_address(cpu, mode, 0), cpu->a);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_STX(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu6502_write(cpu, cpu6502_address(cpu, mode, 0), cpu->x);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_STY(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu6502_write(cpu, cpu6502_address(cpu, mode, 0), cpu->y);
+  cpu6502_next(cpu, mode);
+}
+/* Register transfers */
+static inline void cpu6502_exec_TAX(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->x = cpu->a;
+  cpu6502_set_nz(cpu, cpu->x);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_TAY(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->y = cpu->a;
+  cpu6502_set_nz(cpu, cpu->y);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_TXA(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->a = cpu->x;
+  cpu6502_set_nz(cpu, cpu->a);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_TYA(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->a = cpu->y;
+  cpu6502_set_nz(cpu, cpu->a);
+  cpu6502_next(cpu, mode);
+}
+/* Stack operations */
+static inline void cpu6502_exec_TSX(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->x = cpu->sp;
+  cpu6502_set_nz(cpu, cpu->x);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_TXS(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->sp = cpu->x;
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_PHA(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu6502_push(cpu, cpu->a);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_PHP(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  /* Pushed with the break and unused flags set */
+  cpu6502_push(cpu, cpu->status | STATUS_FLAG_B | STATUS_FLAG_U);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_PLA(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->a = cpu6502_pop(cpu);
+  cpu6502_set_nz(cpu, cpu->a);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_PLP(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  /* The break and unused flags aren't real, so they are left alone */
+  cpu->status = (uint8_t)((cpu6502_pop(cpu) & AFFECTS_ALL) |
+      (cpu->status & ~AFFECTS_ALL));
+  cpu6502_next(cpu, mode);
+}
+/* Logical */
+static inline void cpu6502_exec_AND(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->a &= cpu6502_operand(cpu, mode);
+  cpu6502_set_nz(cpu, cpu->a);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_EOR(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->a ^= cpu6502_operand(cpu, mode);
+  cpu6502_set_nz(cpu, cpu->a);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_ORA(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->a |= cpu6502_operand(cpu, mode);
+  cpu6502_set_nz(cpu, cpu->a);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_BIT(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  uint8_t value = cpu6502_operand(cpu, mode);
+  cpu->flags.z = (cpu->a & value) == 0;
+  cpu->flags.v = (value >> 6) & 1;
+  cpu->flags.n = value >> 7;
+  cpu6502_next(cpu, mode);
+}
+/* Arithmetic */
+static inline void cpu6502_exec_ADC(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  uint8_t value = cpu6502_operand(cpu, mode);
+  if (cpu->flags.d) cpu6502_add_decimal(cpu, value);
+  else cpu6502_add(cpu, value);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_SBC(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  uint8_t value = cpu6502_operand(cpu, mode);
+  if (cpu->flags.d) cpu6502_subtract_decimal(cpu, value);
+  else cpu6502_add(cpu, (uint8_t)~value);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_CMP(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu6502_compare(cpu, mode, cpu->a);
+}
+static inline void cpu6502_exec_CPX(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu6502_compare(cpu, mode, cpu->x);
+}
+static inline void cpu6502_exec_CPY(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu6502_compare(cpu, mode, cpu->y);
+}
+/* Increments & Decrements */
+static inline void cpu6502_exec_INC(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  uint16_t addr = cpu6502_address(cpu, mode, 0);
+  cpu6502_write_back(cpu, mode, addr, (uint8_t)(cpu6502_read(cpu, addr) + 1));
+}
+static inline void cpu6502_exec_INX(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->x++;
+  cpu6502_set_nz(cpu, cpu->x);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_INY(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->y++;
+  cpu6502_set_nz(cpu, cpu->y);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_DEC(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  uint16_t addr = cpu6502_address(cpu, mode, 0);
+  cpu6502_write_back(cpu, mode, addr, (uint8_t)(cpu6502_read(cpu, addr) - 1));
+}
+static inline void cpu6502_exec_DEX(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->x--;
+  cpu6502_set_nz(cpu, cpu->x);
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_DEY(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->y--;
+  cpu6502_set_nz(cpu, cpu->y);
+  cpu6502_next(cpu, mode);
+}
+/* Shifts */
+static inline void cpu6502_exec_ASL(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  uint16_t addr = 0;
+  uint8_t value = cpu->a;
+  if (mode != ADDR_MODE_ACCUMULATOR)
+    value = cpu6502_read(cpu, addr = cpu6502_address(cpu, mode, 0));
+  cpu->flags.c = value >> 7;
+  cpu6502_write_back(cpu, mode, addr, (uint8_t)(value << 1));
+}
+static inline void cpu6502_exec_LSR(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  uint16_t addr = 0;
+  uint8_t value = cpu->a;
+  if (mode != ADDR_MODE_ACCUMULATOR)
+    value = cpu6502_read(cpu, addr = cpu6502_address(cpu, mode, 0));
+  cpu->flags.c = value & 1;
+  cpu6502_write_back(cpu, mode, addr, value >> 1);
+}
+static inline void cpu6502_exec_ROL(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  uint16_t addr = 0;
+  uint8_t value = cpu->a, carry = cpu->flags.c;
+  if (mode != ADDR_MODE_ACCUMULATOR)
+    value = cpu6502_read(cpu, addr = cpu6502_address(cpu, mode, 0));
+  cpu->flags.c = value >> 7;
+  cpu6502_write_back(cpu, mode, addr, (uint8_t)(value << 1 | carry));
+}
+static inline void cpu6502_exec_ROR(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  uint16_t addr = 0;
+  uint8_t value = cpu->a, carry = cpu->flags.c;
+  if (mode != ADDR_MODE_ACCUMULATOR)
+    value = cpu6502_read(cpu, addr = cpu6502_address(cpu, mode, 0));
+  cpu->flags.c = value & 1;
+  cpu6502_write_back(cpu, mode, addr, (uint8_t)(value >> 1 | carry << 7));
+}
+/* Jumps & calls */
+static inline void cpu6502_exec_JMP(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu6502_branch(cpu, BRANCH_KIND_JUMP, cpu6502_address(cpu, mode, 0));
+}
+static inline void cpu6502_exec_JSR(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  /* Pushes the address of its own last byte */
+  uint16_t last = (uint16_t)(cpu->pc + 2);
+  uint16_t to = cpu6502_address(cpu, mode, 0);
+  cpu6502_push(cpu, last >> 8);
+  cpu6502_push(cpu, last & 0xff);
+  cpu6502_branch(cpu, BRANCH_KIND_CALL, to);
+}
+static inline void cpu6502_exec_RTS(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  uint16_t to = cpu6502_pop(cpu);
+  (void)mode;
+  to |= cpu6502_pop(cpu) << 8;
+  cpu6502_branch(cpu, BRANCH_KIND_RETURN, (uint16_t)(to + 1));
+}
+/* Branches */
+static inline void cpu6502_exec_BCC(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  (void)mode;
+  cpu6502_relative(cpu, !cpu->flags.c);
+}
+static inline void cpu6502_exec_BCS(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  (void)mode;
+  cpu6502_relative(cpu, cpu->flags.c);
+}
+static inline void cpu6502_exec_BEQ(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  (void)mode;
+  cpu6502_relative(cpu, cpu->flags.z);
+}
+static inline void cpu6502_exec_BMI(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  (void)mode;
+  cpu6502_relative(cpu, cpu->flags.n);
+}
+static inline void cpu6502_exec_BNE(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  (void)mode;
+  cpu6502_relative(cpu, !cpu->flags.z);
+}
+static inline void cpu6502_exec_BPL(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  (void)mode;
+  cpu6502_relative(cpu, !cpu->flags.n);
+}
+static inline void cpu6502_exec_BVC(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  (void)mode;
+  cpu6502_relative(cpu, !cpu->flags.v);
+}
+static inline void cpu6502_exec_BVS(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  (void)mode;
+  cpu6502_relative(cpu, cpu->flags.v);
+}
+/* Status flag changes */
+static inline void cpu6502_exec_CLC(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->flags.c = 0;
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_CLD(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->flags.d = 0;
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_CLI(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->flags.i = 0;
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_CLV(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->flags.v = 0;
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_SEC(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->flags.c = 1;
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_SED(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->flags.d = 1;
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_SEI(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu->flags.i = 1;
+  cpu6502_next(cpu, mode);
+}
+/* System functions */
+static inline void cpu6502_exec_BRK(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  /* Returns past a padding byte, and pushes the break flag set */
+  uint16_t next = (uint16_t)(cpu->pc + 2);
+  (void)mode;
+  cpu6502_push(cpu, next >> 8);
+  cpu6502_push(cpu, next & 0xff);
+  cpu6502_push(cpu, cpu->status | STATUS_FLAG_B | STATUS_FLAG_U);
+  cpu->flags.i = 1;
+  cpu6502_branch(cpu, BRANCH_KIND_INTERRUPT, cpu6502_read_word(cpu, IRQ_VECTOR));
+}
+static inline void cpu6502_exec_NOP(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu6502_next(cpu, mode);
+}
+static inline void cpu6502_exec_RTI(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  uint16_t to;
+  (void)mode;
+  cpu->status = (uint8_t)((cpu6502_pop(cpu) & AFFECTS_ALL) |
+      (cpu->status & ~AFFECTS_ALL));
+  to = cpu6502_pop(cpu);
+  to |= cpu6502_pop(cpu) << 8;
+  cpu6502_branch(cpu, BRANCH_KIND_RETURN, to);
+}
+/* Unused opcodes */
+static inline void cpu6502_exec_NONE(
+    struct cpu6502 *cpu,
+    enum addressing_modes_6502 mode) {
+  cpu6502_next(cpu, mode);
+}
+
+/* Handler of each instruction, defined below */
+static const cpu6502_handler_fn instruction_handlers_6502[256];
+
+/* Whether an instruction type can start a superinstruction */
+#define CPU6502_FUSES(type) \
+  ((type) == INSTR_TYPE_CMP || (type) == INSTR_TYPE_CPX || \
+   (type) == INSTR_TYPE_CPY || (type) == INSTR_TYPE_LDA || \
+   (type) == INSTR_TYPE_DEX || (type) == INSTR_TYPE_DEY || \
+   (type) == INSTR_TYPE_CLC)
+/* Run the instruction after first too, if the two make a superinstruction */
+static inline void cpu6502_fuse(struct cpu6502 *cpu, uint8_t first) {
+  size_t behind = cpu->cycles_behind;
+  /* An interrupt landing between them is taken there, as if not fused, */
+  /* and so is anything falling due by then */
+  if (cpu->nmi_pending || (cpu->irq_line && !cpu->flags.i) ||
+      cpu->cycles + behind >= cpu->hooks.due_cycle)
+    return;
+  /* Peeking at code on an I/O page could differ from fetching it */
+  if (cpu->page_flags[cpu->pc / PAGE_SIZE] & PAGE_FLAG_IO) return;
+  if (cpu6502_fused_pair(first, cpu6502_peek(cpu, cpu->pc)) == FUSED_PAIR_NONE)
+    return;
+  /* The second sees the machine as if stepped to its own start, so its */
+  /* accesses happen at their own cycles, then both cycles are waited out */
+  cpu->cycles += behind;
+  cpu->cycles_behind = 0;
+  instruction_handlers_6502[cpu6502_read(cpu, cpu->pc)](cpu);
+  cpu->cycles -= behind;
+  cpu->cycles_behind += behind;
+}
+
+/* One handler per opcode, taking its base cycles then running it */
+/* Each is placed in the text section its heat picks */
+#define CPU6502_HANDLER(opcode, mnemonic, mode, cycles, flags, heat) \
+  static CPU6502_##heat void cpu6502_op_##opcode(struct cpu6502 *cpu) { \
+    cpu->cycles_behind += cycles; \
+    cpu6502_exec_##mnemonic(cpu, ADDR_MODE_##mode); \
+    if (CPU6502_FUSES(INSTR_TYPE_##mnemonic)) cpu6502_fuse(cpu, opcode); \
+  }
+CPU6502_OPCODES(CPU6502_HANDLER)
+
+/* Handler of each instruction */
+#define CPU6502_HANDLER_ENTRY(opcode, mnemonic, mode, cycles, flags, heat) \
+  [opcode] = cpu6502_op_##opcode,
+static const cpu6502_handler_fn instruction_handlers_6502[256] = {
+  CPU6502_OPCODES(CPU6502_HANDLER_ENTRY)
+};
+
+/* Disassemble the instruction at addr into buf, returning its length */
+static size_t cpu6502_disassemble(
+    struct cpu6502 *cpu,
+    uint16_t addr,
+    char *buf,
+    size_t size) {
+  uint8_t opcode = cpu6502_peek(cpu, addr);
+  enum addressing_modes_6502 mode = instruction_modes_6502[opcode];
+  unsigned operand = cpu6502_peek(cpu, (uint16_t)(addr + 1));
+  if (mode_lengths_6502[mode] == 3)
+    operand |= cpu6502_peek(cpu, (uint16_t)(addr + 2)) << 8;
+  if (mode == ADDR_MODE_RELATIVE)
+    operand = (uint16_t)(addr + 2 + (int8_t)operand);
+  if (mode == ADDR_MODE_NONE)
+    snprintf(buf, size, mode_formats_6502[mode], opcode);
+  else
+    snprintf(buf, size, mode_formats_6502[mode],
+        instruction_names_6502[opcode], operand);
+  return mode_lengths_6502[mode];
 }
 /* Step the 6502 CPU */
-static void cpu6502_step(struct cpu6502 *cpu) {
+static CPU6502_HOT void cpu6502_step(struct cpu6502 *cpu) {
+  if (cpu->cycles_behind == 0) {
+    /* Between instructions: first whatever has fallen due, as it can */
+    /* raise an interrupt, so every run loop keeps devices on time */
+    if (cpu->cycles >= cpu->hooks.due_cycle && cpu->hooks.due)
+      cpu->hooks.due(cpu, cpu->hooks.due_ctx);
+    /* Then take a pending interrupt, NMI first */
+    if (cpu->nmi_pending) {
+      cpu->nmi_pending = 0;
+      cpu6502_interrupt(cpu, NMI_VECTOR);
+    } else if (cpu->irq_line && !cpu->flags.i) {
+      cpu6502_interrupt(cpu, IRQ_VECTOR);
+    } else {
+      /* Run the next instruction, then wait out its cycles */
+      instruction_handlers_6502[cpu6502_read(cpu, cpu->pc)](cpu);
+    }
+  }
   if (cpu->cycles_behind > 0) {
+    cpu->cycles_behind--;
+  }
+  cpu->cycles++;
+}
+/* Step the 6502 CPU until its cycle counter reaches a cycle */
+static CPU6502_HOT void cpu6502_run(struct cpu6502 *cpu, uint64_t until) {
+  while (cpu->cycles < until) cpu6502_step(cpu);
+}
+
+/* Call a routine with the given registers, running it until it returns */
+/* Either way the caller's PC and stack pointer are restored afterwards, */
+/* so a routine stopped at the cycle limit is abandoned, not resumable */
+static struct cpu6502_call_result cpu6502_call(
+    struct cpu6502 *cpu,
+    uint16_t addr,
+    uint8_t a,
+    uint8_t x,
+    uint8_t y,
+    uint64_t max_cycles) {
+  struct cpu6502_call_result result;
+  uint16_t pc = cpu->pc;
+  uint8_t sp = cpu->sp;
+  uint64_t start = cpu->cycles;
+  /* The routine's RTS pops this and lands on the sentinel */
+  cpu6502_push(cpu, (CALL_SENTINEL - 1) >> 8);
+  cpu6502_push(cpu, (CALL_SENTINEL - 1) & 0xff);
+  cpu->a = a;
+  cpu->x = x;
+  cpu->y = y;
+  cpu6502_branch(cpu, BRANCH_KIND_JUMP, addr);
+  for (;;) {
+    /* Only the matching RTS leaves the stack as it was */
+    /* (checked before the limit, so an RTS ending right on it counts) */
+    if (cpu->cycles_behind == 0 && cpu->pc == CALL_SENTINEL && cpu->sp == sp) {
+      result.reason = STOP_REASON_RETURNED;
+      break;
+    }
+    if (cpu->cycles - start >= max_cycles) {
+      result.reason = STOP_REASON_CYCLE_LIMIT;
+      break;
+    }
+    cpu6502_step(cpu);
   }
-  cpu->cycles_behind--;
+  result.a = cpu->a;
+  result.x = cpu->x;
+  result.y = cpu->y;
+  result.status = cpu->status;
+  result.sp = cpu->sp;
+  result.cycles = cpu->cycles - start;
+  /* Drop whatever the routine left on the stack, sentinel included */
+  cpu->sp = sp;
+  cpu6502_branch(cpu, BRANCH_KIND_JUMP, pc);
+  return result;
 }
 
 #endif /* CPU6502_H */
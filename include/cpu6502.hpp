@@ -0,0 +1,569 @@
+/* Include guard */
+#if !defined(CPU6502_HPP)
+#define CPU6502_HPP
+
+/* Includes */
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "cpu6502_opcodes.h"
+
+/*
+ * C++17 core for embedders with a fixed memory map.
+ * Bus is any class with
+ *   uint8_t read(uint16_t addr);
+ *   void write(uint16_t addr, uint8_t value);
+ * which the CPU calls directly rather than through pointers, so they
+ * inline into it. There is no sparse RAM, paging, wait states or hooks
+ * here: the bus model owns all of that. Instructions run as in the C
+ * core: the whole instruction at its first cycle, then its cycles are
+ * waited out.
+ */
+
+/* Addressing modes for each instruction, from the opcode list */
+inline constexpr std::array<addressing_modes_6502, 256> cpu6502_instruction_modes =
+  [] {
+    std::array<addressing_modes_6502, 256> table{};
+#define CPU6502_MODE_ENTRY(opcode, mnemonic, mode, cycles, flags, heat) \
+    table[opcode] = ADDR_MODE_##mode;
+    CPU6502_OPCODES(CPU6502_MODE_ENTRY)
+#undef CPU6502_MODE_ENTRY
+    return table;
+  }();
+
+/* Instruction types for each instruction, from the opcode list */
+inline constexpr std::array<instr_types_6502, 256> cpu6502_instruction_types =
+  [] {
+    std::array<instr_types_6502, 256> table{};
+#define CPU6502_TYPE_ENTRY(opcode, mnemonic, mode, cycles, flags, heat) \
+    table[opcode] = INSTR_TYPE_##mnemonic;
+    CPU6502_OPCODES(CPU6502_TYPE_ENTRY)
+#undef CPU6502_TYPE_ENTRY
+    return table;
+  }();
+
+/* 6502 CPU on a bus */
+template<class Bus>
+class Cpu6502 {
+public:
+  /* Interrupt vectors */
+  static constexpr uint16_t nmi_vector = 0xfffa;
+  static constexpr uint16_t reset_vector = 0xfffc;
+  static constexpr uint16_t irq_vector = 0xfffe;
+
+  uint16_t pc = 0;          /* Program counter */
+  uint8_t sp = 0xff;        /* Stack pointer = 0x0100 | sp */
+  uint8_t a = 0;            /* Accumulator */
+  uint8_t x = 0;            /* Index register X */
+  uint8_t y = 0;            /* Index register Y */
+  uint8_t status = 0;       /* Status register */
+  size_t cycles_behind = 0; /* Number of cycles the CPU is behind */
+  uint64_t cycles = 0;      /* Number of cycles stepped since power on */
+  bool nmi_pending = false; /* An NMI edge is waiting to be serviced */
+  bool irq_line = false;    /* The IRQ line is asserted */
+
+  explicit Cpu6502(Bus &bus) : bus_(bus) {}
+
+  /* Get the bus */
+  Bus &bus() { return bus_; }
+  /* Get an opcode's addressing mode */
+  static constexpr addressing_modes_6502 mode(uint8_t opcode) {
+    return cpu6502_instruction_modes[opcode];
+  }
+  /* Get an opcode's instruction type */
+  static constexpr instr_types_6502 type(uint8_t opcode) {
+    return cpu6502_instruction_types[opcode];
+  }
+  /* Read a byte from the bus */
+  uint8_t read(uint16_t addr) { return bus_.read(addr); }
+  /* Write a byte to the bus */
+  void write(uint16_t addr, uint8_t value) { bus_.write(addr, value); }
+  /* Push a byte onto the stack */
+  void push(uint8_t value) {
+    write(0x0100 | sp, value);
+    sp--;
+  }
+  /* Reset the CPU (registers only, as cpu6502_reset) */
+  void reset() {
+    /* Resetting takes 6 cycles, according to wikipedia */
+    cycles_behind = 6;
+    /* Interrupt disable and zero set, decimal, negative, overflow, carry clear */
+    status = (uint8_t)((status | STATUS_FLAG_I | STATUS_FLAG_Z) &
+        ~(STATUS_FLAG_D | STATUS_FLAG_N | STATUS_FLAG_V | STATUS_FLAG_C));
+    pc = read16(reset_vector);
+    sp = 0xff;
+    a = 0;
+    x = 0;
+    y = 0;
+    nmi_pending = false;
+  }
+  /* Signal an NMI (edge triggered, taken before the next instruction) */
+  void nmi() { nmi_pending = true; }
+  /* Assert or release the IRQ line (level triggered, masked by the I flag) */
+  void irq(bool asserted) { irq_line = asserted; }
+  /* Step the CPU */
+  void step() {
+    if (cycles_behind == 0) {
+      /* Between instructions: take a pending interrupt, NMI first */
+      if (nmi_pending) {
+        nmi_pending = false;
+        interrupt(nmi_vector);
+      } else if (irq_line && !(status & STATUS_FLAG_I)) {
+        interrupt(irq_vector);
+      } else {
+        /* Run the next instruction, then wait out its cycles */
+        execute(read(pc));
+      }
+    }
+    if (cycles_behind > 0) {
+      cycles_behind--;
+    }
+    cycles++;
+  }
+  /* Step the CPU until its cycle counter reaches a cycle */
+  void run(uint64_t until) {
+    while (cycles < until) step();
+  }
+
+private:
+  /* Run an instruction, through a handler generated from the opcode list */
+  /* Each takes its base cycles, then runs its type with its mode constant */
+  void execute(uint8_t opcode) {
+    switch (opcode) {
+#define CPU6502_HANDLER(opcode, mnemonic, mode, cycles, flags, heat) \
+    case opcode: \
+      cycles_behind += cycles; \
+      exec_##mnemonic<ADDR_MODE_##mode>(); \
+      break;
+    CPU6502_OPCODES(CPU6502_HANDLER)
+#undef CPU6502_HANDLER
+    }
+  }
+  /* Read a little-endian word from the bus */
+  uint16_t read16(uint16_t addr) {
+    return (uint16_t)(read(addr) | (read((uint16_t)(addr + 1)) << 8));
+  }
+  /* Read a little-endian word from zero page, wrapping within it */
+  uint16_t read16_zero_page(uint8_t addr) {
+    return (uint16_t)(read(addr) | (read((uint8_t)(addr + 1)) << 8));
+  }
+  /* Pop a byte off the stack */
+  uint8_t pop() {
+    sp++;
+    return read(0x0100 | sp);
+  }
+  /* Set or clear a status flag */
+  void set_flag(status_flags_6502 flag, bool value) {
+    status = (uint8_t)(value ? status | flag : status & ~flag);
+  }
+  /* Set the negative and zero flags from a result */
+  void set_nz(uint8_t value) {
+    set_flag(STATUS_FLAG_Z, value == 0);
+    set_flag(STATUS_FLAG_N, value & 0x80);
+  }
+  /* Move the PC past the current instruction */
+  template<addressing_modes_6502 M>
+  void next() {
+    constexpr uint16_t length =
+      M == ADDR_MODE_ACCUMULATOR || M == ADDR_MODE_IMPLIED ||
+      M == ADDR_MODE_NONE ? 1 :
+      M == ADDR_MODE_ABSOLUTE || M == ADDR_MODE_ABSOLUTE_X ||
+      M == ADDR_MODE_ABSOLUTE_Y || M == ADDR_MODE_INDIRECT ? 3 : 2;
+    pc = (uint16_t)(pc + length);
+  }
+  /* Get the address the current instruction operates on */
+  /* Indexing across a page costs a cycle if Crossing is set (reads only) */
+  template<addressing_modes_6502 M, bool Crossing>
+  uint16_t address() {
+    const uint16_t operand = (uint16_t)(pc + 1);
+    uint16_t base = 0, addr = 0;
+    if constexpr (M == ADDR_MODE_IMMEDIATE) {
+      return operand;
+    } else if constexpr (M == ADDR_MODE_ZERO_PAGE) {
+      return read(operand);
+    } else if constexpr (M == ADDR_MODE_ZERO_PAGE_X) {
+      return (uint8_t)(read(operand) + x);
+    } else if constexpr (M == ADDR_MODE_ZERO_PAGE_Y) {
+      return (uint8_t)(read(operand) + y);
+    } else if constexpr (M == ADDR_MODE_ABSOLUTE) {
+      return read16(operand);
+    } else if constexpr (M == ADDR_MODE_INDIRECT) {
+      /* The pointer's high byte never comes from the next page (NMOS bug) */
+      base = read16(operand);
+      return (uint16_t)(read(base) |
+          (read((uint16_t)((base & 0xff00) | ((base + 1) & 0xff))) << 8));
+    } else if constexpr (M == ADDR_MODE_INDIRECT_X) {
+      return read16_zero_page((uint8_t)(read(operand) + x));
+    } else if constexpr (M == ADDR_MODE_ABSOLUTE_X ||
+        M == ADDR_MODE_ABSOLUTE_Y || M == ADDR_MODE_INDIRECT_Y) {
+      if constexpr (M == ADDR_MODE_ABSOLUTE_X) {
+        base = read16(operand);
+        addr = (uint16_t)(base + x);
+      } else if constexpr (M == ADDR_MODE_ABSOLUTE_Y) {
+        base = read16(operand);
+        addr = (uint16_t)(base + y);
+      } else {
+        base = read16_zero_page(read(operand));
+        addr = (uint16_t)(base + y);
+      }
+      if (Crossing && ((base ^ addr) & 0xff00)) cycles_behind++;
+      return addr;
+    } else {
+      return 0;
+    }
+  }
+  /* Read the value the current instruction operates on */
+  template<addressing_modes_6502 M>
+  uint8_t operand() {
+    if constexpr (M == ADDR_MODE_ACCUMULATOR) return a;
+    else return read(address<M, true>());
+  }
+  /* Read the value a read-modify-write instruction operates on */
+  template<addressing_modes_6502 M>
+  uint8_t modify(uint16_t &addr) {
+    if constexpr (M == ADDR_MODE_ACCUMULATOR) return a;
+    else return read(addr = address<M, false>());
+  }
+  /* Write the result of a read-modify-write instruction back */
+  template<addressing_modes_6502 M>
+  void write_back(uint16_t addr, uint8_t value) {
+    if constexpr (M == ADDR_MODE_ACCUMULATOR) a = value;
+    else write(addr, value);
+    set_nz(value);
+    next<M>();
+  }
+  /* Take a relative branch if a condition holds */
+  void relative(bool taken) {
+    const uint16_t next = (uint16_t)(pc + 2);
+    uint16_t to;
+    if (!taken) {
+      pc = next;
+      return;
+    }
+    to = (uint16_t)(next + (int8_t)read((uint16_t)(pc + 1)));
+    /* A taken branch costs a cycle, and another if it crosses a page */
+    cycles_behind += (next ^ to) & 0xff00 ? 2 : 1;
+    pc = to;
+  }
+  /* Compare a register with the operand */
+  template<addressing_modes_6502 M>
+  void compare(uint8_t reg) {
+    const uint8_t value = operand<M>();
+    set_flag(STATUS_FLAG_C, reg >= value);
+    set_nz((uint8_t)(reg - value));
+    next<M>();
+  }
+  /* Add in binary */
+  void add(uint8_t value) {
+    const unsigned sum = a + value + (status & STATUS_FLAG_C);
+    set_flag(STATUS_FLAG_V, (~(a ^ value) & (a ^ sum)) & 0x80);
+    set_flag(STATUS_FLAG_C, sum > 0xff);
+    a = (uint8_t)sum;
+    set_nz(a);
+  }
+  /* Add in decimal, with the NMOS flags (N, V and Z as in binary) */
+  void add_decimal(uint8_t value) {
+    const unsigned carry = status & STATUS_FLAG_C;
+    unsigned lo = (a & 0x0f) + (value & 0x0f) + carry, hi;
+    if (lo > 9) lo += 6;
+    hi = (a >> 4) + (value >> 4) + (lo > 0x0f);
+    set_flag(STATUS_FLAG_Z, ((a + value + carry) & 0xff) == 0);
+    set_flag(STATUS_FLAG_N, (hi >> 3) & 1);
+    set_flag(STATUS_FLAG_V, (~(a ^ value) & (a ^ (hi << 4))) & 0x80);
+    if (hi > 9) hi += 6;
+    set_flag(STATUS_FLAG_C, hi > 0x0f);
+    a = (uint8_t)((hi << 4) | (lo & 0x0f));
+  }
+  /* Subtract in decimal, with the NMOS flags (all as in binary) */
+  void subtract_decimal(uint8_t value) {
+    int lo = (a & 0x0f) - (value & 0x0f) - !(status & STATUS_FLAG_C);
+    int hi = (a >> 4) - (value >> 4);
+    if (lo < 0) {
+      lo -= 6;
+      hi--;
+    }
+    if (hi < 0) hi -= 6;
+    add((uint8_t)~value);
+    /* Unsigned, as hi can be negative */
+    a = (uint8_t)(((unsigned)hi << 4) | (lo & 0x0f));
+  }
+  /* Take an interrupt through a vector, which takes 7 cycles */
+  void interrupt(uint16_t vector) {
+    push((uint8_t)(pc >> 8));
+    push((uint8_t)(pc & 0xff));
+    /* Pushed with the break flag clear and the unused flag set */
+    push((uint8_t)((status | STATUS_FLAG_U) & ~STATUS_FLAG_B));
+    status |= STATUS_FLAG_I;
+    pc = read16(vector);
+    cycles_behind += 7;
+  }
+
+  /* Load/store */
+  template<addressing_modes_6502 M> void exec_LDA() {
+    a = operand<M>();
+    set_nz(a);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_LDX() {
+    x = operand<M>();
+    set_nz(x);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_LDY() {
+    y = operand<M>();
+    set_nz(y);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_STA() {
+    write(address<M, false>(), a);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_STX() {
+    write(address<M, false>(), x);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_STY() {
+    write(address<M, false>(), y);
+    next<M>();
+  }
+  /* Register transfers */
+  template<addressing_modes_6502 M> void exec_TAX() {
+    x = a;
+    set_nz(x);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_TAY() {
+    y = a;
+    set_nz(y);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_TXA() {
+    a = x;
+    set_nz(a);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_TYA() {
+    a = y;
+    set_nz(a);
+    next<M>();
+  }
+  /* Stack operations */
+  template<addressing_modes_6502 M> void exec_TSX() {
+    x = sp;
+    set_nz(x);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_TXS() {
+    sp = x;
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_PHA() {
+    push(a);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_PHP() {
+    /* Pushed with the break and unused flags set */
+    push((uint8_t)(status | STATUS_FLAG_B | STATUS_FLAG_U));
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_PLA() {
+    a = pop();
+    set_nz(a);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_PLP() {
+    /* The break and unused flags aren't real, so they are left alone */
+    status = (uint8_t)((pop() & AFFECTS_ALL) | (status & ~AFFECTS_ALL));
+    next<M>();
+  }
+  /* Logical */
+  template<addressing_modes_6502 M> void exec_AND() {
+    a &= operand<M>();
+    set_nz(a);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_EOR() {
+    a ^= operand<M>();
+    set_nz(a);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_ORA() {
+    a |= operand<M>();
+    set_nz(a);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_BIT() {
+    const uint8_t value = operand<M>();
+    set_flag(STATUS_FLAG_Z, (a & value) == 0);
+    set_flag(STATUS_FLAG_V, value & 0x40);
+    set_flag(STATUS_FLAG_N, value & 0x80);
+    next<M>();
+  }
+  /* Arithmetic */
+  template<addressing_modes_6502 M> void exec_ADC() {
+    const uint8_t value = operand<M>();
+    if (status & STATUS_FLAG_D) add_decimal(value);
+    else add(value);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_SBC() {
+    const uint8_t value = operand<M>();
+    if (status & STATUS_FLAG_D) subtract_decimal(value);
+    else add((uint8_t)~value);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_CMP() { compare<M>(a); }
+  template<addressing_modes_6502 M> void exec_CPX() { compare<M>(x); }
+  template<addressing_modes_6502 M> void exec_CPY() { compare<M>(y); }
+  /* Increments & Decrements */
+  template<addressing_modes_6502 M> void exec_INC() {
+    const uint16_t addr = address<M, false>();
+    write_back<M>(addr, (uint8_t)(read(addr) + 1));
+  }
+  template<addressing_modes_6502 M> void exec_INX() {
+    x++;
+    set_nz(x);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_INY() {
+    y++;
+    set_nz(y);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_DEC() {
+    const uint16_t addr = address<M, false>();
+    write_back<M>(addr, (uint8_t)(read(addr) - 1));
+  }
+  template<addressing_modes_6502 M> void exec_DEX() {
+    x--;
+    set_nz(x);
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_DEY() {
+    y--;
+    set_nz(y);
+    next<M>();
+  }
+  /* Shifts */
+  template<addressing_modes_6502 M> void exec_ASL() {
+    uint16_t addr = 0;
+    const uint8_t value = modify<M>(addr);
+    set_flag(STATUS_FLAG_C, value & 0x80);
+    write_back<M>(addr, (uint8_t)(value << 1));
+  }
+  template<addressing_modes_6502 M> void exec_LSR() {
+    uint16_t addr = 0;
+    const uint8_t value = modify<M>(addr);
+    set_flag(STATUS_FLAG_C, value & 1);
+    write_back<M>(addr, (uint8_t)(value >> 1));
+  }
+  template<addressing_modes_6502 M> void exec_ROL() {
+    uint16_t addr = 0;
+    const uint8_t carry = status & STATUS_FLAG_C;
+    const uint8_t value = modify<M>(addr);
+    set_flag(STATUS_FLAG_C, value & 0x80);
+    write_back<M>(addr, (uint8_t)(value << 1 | carry));
+  }
+  template<addressing_modes_6502 M> void exec_ROR() {
+    uint16_t addr = 0;
+    const uint8_t carry = status & STATUS_FLAG_C;
+    const uint8_t value = modify<M>(addr);
+    set_flag(STATUS_FLAG_C, value & 1);
+    write_back<M>(addr, (uint8_t)(value >> 1 | carry << 7));
+  }
+  /* Jumps & calls */
+  template<addressing_modes_6502 M> void exec_JMP() {
+    pc = address<M, false>();
+  }
+  template<addressing_modes_6502 M> void exec_JSR() {
+    /* Pushes the address of its own last byte */
+    const uint16_t last = (uint16_t)(pc + 2);
+    const uint16_t to = address<M, false>();
+    push((uint8_t)(last >> 8));
+    push((uint8_t)(last & 0xff));
+    pc = to;
+  }
+  template<addressing_modes_6502 M> void exec_RTS() {
+    uint16_t to = pop();
+    to = (uint16_t)(to | pop() << 8);
+    pc = (uint16_t)(to + 1);
+  }
+  /* Branches */
+  template<addressing_modes_6502 M> void exec_BCC() {
+    relative(!(status & STATUS_FLAG_C));
+  }
+  template<addressing_modes_6502 M> void exec_BCS() {
+    relative(status & STATUS_FLAG_C);
+  }
+  template<addressing_modes_6502 M> void exec_BEQ() {
+    relative(status & STATUS_FLAG_Z);
+  }
+  template<addressing_modes_6502 M> void exec_BMI() {
+    relative(status & STATUS_FLAG_N);
+  }
+  template<addressing_modes_6502 M> void exec_BNE() {
+    relative(!(status & STATUS_FLAG_Z));
+  }
+  template<addressing_modes_6502 M> void exec_BPL() {
+    relative(!(status & STATUS_FLAG_N));
+  }
+  template<addressing_modes_6502 M> void exec_BVC() {
+    relative(!(status & STATUS_FLAG_V));
+  }
+  template<addressing_modes_6502 M> void exec_BVS() {
+    relative(status & STATUS_FLAG_V);
+  }
+  /* Status flag changes */
+  template<addressing_modes_6502 M> void exec_CLC() {
+    status &= (uint8_t)~STATUS_FLAG_C;
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_CLD() {
+    status &= (uint8_t)~STATUS_FLAG_D;
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_CLI() {
+    status &= (uint8_t)~STATUS_FLAG_I;
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_CLV() {
+    status &= (uint8_t)~STATUS_FLAG_V;
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_SEC() {
+    status |= STATUS_FLAG_C;
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_SED() {
+    status |= STATUS_FLAG_D;
+    next<M>();
+  }
+  template<addressing_modes_6502 M> void exec_SEI() {
+    status |= STATUS_FLAG_I;
+    next<M>();
+  }
+  /* System functions */
+  template<addressing_modes_6502 M> void exec_BRK() {
+    /* Returns past a padding byte, and pushes the break flag set */
+    const uint16_t next = (uint16_t)(pc + 2);
+    push((uint8_t)(next >> 8));
+    push((uint8_t)(next & 0xff));
+    push((uint8_t)(status | STATUS_FLAG_B | STATUS_FLAG_U));
+    status |= STATUS_FLAG_I;
+    pc = read16(irq_vector);
+  }
+  template<addressing_modes_6502 M> void exec_NOP() { next<M>(); }
+  template<addressing_modes_6502 M> void exec_RTI() {
+    uint16_t to;
+    status = (uint8_t)((pop() & AFFECTS_ALL) | (status & ~AFFECTS_ALL));
+    to = pop();
+    to = (uint16_t)(to | pop() << 8);
+    pc = to;
+  }
+  /* Unused opcodes */
+  template<addressing_modes_6502 M> void exec_NONE() { next<M>(); }
+
+  Bus &bus_;                /* The bus, called directly */
+};
+
+#endif /* CPU6502_HPP */
@@ -0,0 +1,189 @@
+/* Include guard */
+#if !defined(CPU6502_ANALYZE_H)
+#define CPU6502_ANALYZE_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include "cpu6502_trace.h"
+
+/* Constants */
+/* Chunks per thread, so threads that finish early can take more */
+#define ANALYZE_CHUNKS_PER_THREAD 8
+
+/*
+ * Map/reduce over the events of a trace.
+ * Each chunk gets its own accumulator of acc_size bytes, set up by init
+ * and fed every event of the chunk (keyframes included) by map, on
+ * whichever thread takes the chunk. The accumulators are then reduced
+ * into the result in trace order, on the calling thread.
+ */
+struct cpu6502_trace_job {
+  size_t acc_size;      /* Size of an accumulator, in bytes */
+  void (*init)(void *acc, void *ctx); /* Set up an empty accumulator */
+  /* Add an event to an accumulator */
+  void (*map)(void *acc, const struct cpu6502_trace_event *event, void *ctx);
+  /* Add an accumulator to another, which holds earlier events */
+  void (*reduce)(void *into, const void *acc, void *ctx);
+  void *ctx;            /* Passed to the callbacks */
+};
+
+/* A trace being analyzed, shared by the worker threads */
+struct cpu6502_analyze {
+  const char *path;     /* Path of the trace */
+  const struct cpu6502_trace_job *job; /* What to do with it */
+  uint64_t *offsets;    /* File offset of each keyframe */
+  size_t keyframes;     /* Number of keyframes */
+  uint64_t end;         /* File offset the records end at */
+  size_t chunks;        /* Number of chunks */
+  uint8_t *accs;        /* Each chunk's accumulator */
+  uint8_t *errors;      /* Whether each chunk failed to read */
+  atomic_size_t next;   /* The next chunk to take */
+};
+
+/* Find the keyframes of a trace, from its index or by reading it */
+/* Fills in offsets (freed by the caller), keyframes and end (0 on success) */
+static int cpu6502_trace_keyframes(struct cpu6502_analyze *an) {
+  struct cpu6502_trace_reader reader;
+  struct cpu6502_trace_event event;
+  uint8_t footer[TRACE_FOOTER_SIZE];
+  uint64_t value[3] = { 0 }, pos, delta, *offsets;
+  size_t i, capacity = 0;
+  FILE *in = fopen(an->path, "rb");
+  int result;
+  an->offsets = NULL;
+  an->keyframes = 0;
+  if (!in) return -1;
+  if (!fseeko(in, -(off_t)TRACE_FOOTER_SIZE, SEEK_END) &&
+      fread(footer, 1, TRACE_FOOTER_SIZE, in) == TRACE_FOOTER_SIZE) {
+    for (i = 0; i < TRACE_FOOTER_SIZE; i++)
+      value[i / 8] |= (uint64_t)footer[i] << (8 * (i % 8));
+  }
+  /* The footer locates the index, of keyframe offsets as varint deltas */
+  if (value[2] == TRACE_INDEX_MAGIC &&
+      (an->offsets = malloc((value[1] ? value[1] : 1) * sizeof(uint64_t)))) {
+    rewind(in);
+    if (!cpu6502_trace_open(&reader, in) &&
+        !cpu6502_trace_seek(&reader, value[0], UINT64_MAX)) {
+      for (pos = 0; an->keyframes < value[1]; an->keyframes++) {
+        if (cpu6502_trace_get(&reader, &delta) <= 0) break;
+        pos += delta;
+        an->offsets[an->keyframes] = pos;
+      }
+    }
+    if (an->keyframes == value[1]) {
+      an->end = value[0];
+      fclose(in);
+      return 0;
+    }
+  }
+  /* No index, as when the trace wasn't finished: read it all */
+  free(an->offsets);
+  an->offsets = NULL;
+  an->keyframes = 0;
+  rewind(in);
+  if (cpu6502_trace_open(&reader, in)) {
+    fclose(in);
+    return -1;
+  }
+  for (;;) {
+    pos = reader.pos;
+    if ((result = cpu6502_trace_next(&reader, &event)) <= 0) break;
+    if (event.kind != TRACE_KEYFRAME) continue;
+    if (an->keyframes == capacity) {
+      capacity = 2 * capacity + 64;
+      offsets = realloc(an->offsets, capacity * sizeof(uint64_t));
+      if (!offsets) {
+        fclose(in);
+        return -1;
+      }
+      an->offsets = offsets;
+    }
+    an->offsets[an->keyframes++] = pos;
+  }
+  /* A record cut short ends the trace just before it */
+  an->end = result < 0 ? pos : reader.pos;
+  fclose(in);
+  return 0;
+}
+/* Worker thread, running chunks until there are none left */
+static int cpu6502_analyze_worker(void *arg) {
+  struct cpu6502_analyze *an = arg;
+  const struct cpu6502_trace_job *job = an->job;
+  struct cpu6502_trace_reader reader;
+  struct cpu6502_trace_event event;
+  size_t chunk, first, last;
+  uint8_t *acc;
+  FILE *in = fopen(an->path, "rb");
+  int ok = in && !cpu6502_trace_open(&reader, in), result;
+  while ((chunk = atomic_fetch_add(&an->next, 1)) < an->chunks) {
+    acc = an->accs + chunk * job->acc_size;
+    job->init(acc, job->ctx);
+    /* A chunk is a run of whole keyframe intervals */
+    first = chunk * an->keyframes / an->chunks;
+    last = (chunk + 1) * an->keyframes / an->chunks;
+    if (!ok || cpu6502_trace_seek(&reader, an->offsets[first],
+          last < an->keyframes ? an->offsets[last] : an->end)) {
+      an->errors[chunk] = 1;
+      continue;
+    }
+    while ((result = cpu6502_trace_next(&reader, &event)) > 0)
+      job->map(acc, &event, job->ctx);
+    if (result < 0) an->errors[chunk] = 1;
+  }
+  if (in) fclose(in);
+  return 0;
+}
+/* Run a job over a trace file on a number of threads (0 on success) */
+/* The result is an accumulator, for the reduced result of every chunk */
+static int cpu6502_trace_analyze(
+    const char *path,
+    size_t threads,
+    const struct cpu6502_trace_job *job,
+    void *result) {
+  struct cpu6502_analyze an;
+  thrd_t *workers;
+  size_t i, started = 0;
+  int failed = 0;
+  an.path = path;
+  an.job = job;
+  if (cpu6502_trace_keyframes(&an)) return -1;
+  if (threads == 0) threads = 1;
+  an.chunks = threads * ANALYZE_CHUNKS_PER_THREAD;
+  if (an.chunks > an.keyframes) an.chunks = an.keyframes;
+  an.accs = malloc(an.chunks * job->acc_size + 1);
+  an.errors = calloc(an.chunks + 1, 1);
+  workers = malloc(threads * sizeof(thrd_t));
+  if (!an.accs || !an.errors || !workers) {
+    free(an.offsets);
+    free(an.accs);
+    free(an.errors);
+    free(workers);
+    return -1;
+  }
+  atomic_init(&an.next, 0);
+  /* This thread works too, so a failure to start threads only slows it */
+  for (i = 1; i < threads; i++)
+    if (thrd_create(&workers[started], cpu6502_analyze_worker, &an) ==
+        thrd_success)
+      started++;
+  cpu6502_analyze_worker(&an);
+  for (i = 0; i < started; i++)
+    thrd_join(workers[i], NULL);
+  job->init(result, job->ctx);
+  for (i = 0; i < an.chunks; i++) {
+    failed |= an.errors[i];
+    job->reduce(result, an.accs + i * job->acc_size, job->ctx);
+  }
+  free(an.offsets);
+  free(an.accs);
+  free(an.errors);
+  free(workers);
+  return failed ? -1 : 0;
+}
+
+#endif /* CPU6502_ANALYZE_H */
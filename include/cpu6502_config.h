@@ -0,0 +1,350 @@
+/* Include guard */
+#if !defined(CPU6502_CONFIG_H)
+#define CPU6502_CONFIG_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "cpu6502.h"
+
+/*
+ * Machine description files.
+ * A description is a text file of "key = value" lines, with "#" or ";"
+ * starting a comment. Numbers may be decimal (leading zeros too) or
+ * 0x-prefixed hex, and ranges are inclusive. The keys are:
+ *   clock = HZ                          Clock rate
+ *   cpu = 6502                          CPU variant (only NMOS is emulated)
+ *   ram = START-END                     RAM, page aligned
+ *   rom = START-END [FILE]              ROM, page aligned, loaded from FILE
+ *                                       (exactly the size of the range)
+ *   wait = START-END CYCLES             Wait states of a range of pages
+ *   device = NAME START-END             Device registers
+ *   bank = REG START-END BASE COUNT     COUNT banks of RAM from offset BASE,
+ *                                       switched into START-END by REG;
+ *                                       BASE is above the first 64KiB,
+ *                                       which the address space maps
+ * Pages not given as RAM, ROM, a device or a bank window ignore writes.
+ * A description is parsed once into the same tables cpu6502 uses, so
+ * applying it is a handful of copies.
+ */
+
+/* Maximum length of a device name, including the terminator */
+#define DEVICE_NAME_SIZE    32
+/* Maximum length of a line of a machine description */
+#define CONFIG_LINE_SIZE    256
+
+/* CPU variants */
+enum cpu_variants_6502 {
+  CPU_VARIANT_NMOS=0,       /* The original NMOS 6502 */
+  CPU_VARIANT_CMOS=1,       /* The CMOS 65C02 */
+};
+
+/* The registers of a device, for the host to attach it to */
+struct cpu6502_device_range {
+  char name[DEVICE_NAME_SIZE]; /* Name given in the description */
+  uint16_t start;           /* First address */
+  uint16_t end;             /* Last address */
+};
+
+/* A parsed machine description */
+struct cpu6502_config {
+  uint64_t clock_hz;        /* Clock rate, in Hz */
+  enum cpu_variants_6502 variant; /* CPU variant */
+  uint32_t page_map[ADDR_PAGE_COUNT];   /* As in struct cpu6502 */
+  uint8_t page_flags[ADDR_PAGE_COUNT];  /* As in struct cpu6502 */
+  uint8_t wait_states[ADDR_PAGE_COUNT]; /* As in struct cpu6502 */
+  struct cpu6502_bank banks[MAX_BANKS]; /* As in struct cpu6502 */
+  size_t bank_count;        /* As in struct cpu6502 */
+  struct cpu6502_device_range devices[MAX_DEVICES]; /* Devices */
+  size_t device_count;      /* Number of devices */
+  uint8_t image[0x10000];   /* Contents of ROM, by address */
+  uint8_t claimed[ADDR_PAGE_COUNT]; /* What claimed each page, while parsing */
+  char error[CONFIG_LINE_SIZE]; /* Why parsing failed */
+};
+
+/* What claimed a page, while parsing */
+enum config_claims_6502 {
+  CONFIG_CLAIM_NONE=0,      /* Nothing yet */
+  CONFIG_CLAIM_MEMORY=1,    /* RAM, ROM or a bank window */
+  CONFIG_CLAIM_DEVICE=2,    /* One or more devices */
+};
+
+/* Record why parsing failed, returning -1 */
+static int cpu6502_config_fail(
+    struct cpu6502_config *config,
+    unsigned line,
+    const char *message) {
+  snprintf(config->error, sizeof(config->error), "line %u: %s", line, message);
+  return -1;
+}
+/* Parse a number, advancing past it (0 on success) */
+static int cpu6502_config_number(const char **s, uint32_t *value) {
+  char *end;
+  unsigned long n;
+  int base = 10;
+  while (isspace((unsigned char)**s)) (*s)++;
+  /* Only 0x means another base; a leading 0 isn't octal */
+  if ((*s)[0] == '0' && ((*s)[1] == 'x' || (*s)[1] == 'X')) {
+    *s += 2;
+    base = 16;
+  }
+  if (!isxdigit((unsigned char)**s) ||
+      (base == 10 && !isdigit((unsigned char)**s)))
+    return -1;
+  n = strtoul(*s, &end, base);
+  if (n > UINT32_MAX) return -1;
+  *s = end;
+  *value = (uint32_t)n;
+  return 0;
+}
+/* Parse an inclusive range of addresses, advancing past it (0 on success) */
+static int cpu6502_config_range(const char **s, uint16_t *start, uint16_t *end) {
+  uint32_t a, b;
+  if (cpu6502_config_number(s, &a) || **s != '-') return -1;
+  (*s)++;
+  if (cpu6502_config_number(s, &b) || a > b || b > 0xffff) return -1;
+  *start = (uint16_t)a;
+  *end = (uint16_t)b;
+  return 0;
+}
+/* Parse a word, advancing past it (0 on success) */
+static int cpu6502_config_word(const char **s, char *word, size_t size) {
+  size_t n = 0;
+  while (isspace((unsigned char)**s)) (*s)++;
+  while (**s && !isspace((unsigned char)**s)) {
+    if (n + 1 == size) return -1;
+    word[n++] = *(*s)++;
+  }
+  word[n] = 0;
+  return n ? 0 : -1;
+}
+/* Check nothing but space is left on a line */
+static int cpu6502_config_end(const char *s) {
+  while (isspace((unsigned char)*s)) s++;
+  return *s ? -1 : 0;
+}
+/* Claim the pages of a range (0 on success, -1 if already claimed) */
+static int cpu6502_config_claim(
+    struct cpu6502_config *config,
+    uint16_t start,
+    uint16_t end,
+    enum config_claims_6502 claim) {
+  size_t page;
+  for (page = start / PAGE_SIZE; page <= end / PAGE_SIZE; page++) {
+    if (config->claimed[page] == CONFIG_CLAIM_NONE) continue;
+    /* Devices may share a page with other devices, nothing else may */
+    if (claim == CONFIG_CLAIM_DEVICE &&
+        config->claimed[page] == CONFIG_CLAIM_DEVICE) continue;
+    return -1;
+  }
+  for (page = start / PAGE_SIZE; page <= end / PAGE_SIZE; page++)
+    config->claimed[page] = (uint8_t)claim;
+  return 0;
+}
+/* Load a ROM file, relative to the description's directory (0 on success) */
+static int cpu6502_config_load_rom(
+    struct cpu6502_config *config,
+    const char *dir,
+    size_t dir_size,
+    const char *file,
+    uint16_t start,
+    uint16_t end) {
+  char path[CONFIG_LINE_SIZE * 2];
+  FILE *f;
+  size_t size = (size_t)end - start + 1, n;
+  if (file[0] == '/') dir_size = 0;
+  if (dir_size + strlen(file) + 1 > sizeof(path)) return -1;
+  memcpy(path, dir, dir_size);
+  strcpy(path + dir_size, file);
+  f = fopen(path, "rb");
+  if (!f) return -1;
+  n = fread(config->image + start, 1, size, f);
+  /* The file must fill its range exactly */
+  if (n == size && fgetc(f) != EOF) n = 0;
+  fclose(f);
+  return n == size ? 0 : -1;
+}
+/* Parse one "key = value" line (0 on success) */
+static int cpu6502_config_line(
+    struct cpu6502_config *config,
+    unsigned number,
+    const char *key,
+    const char *value,
+    const char *dir,
+    size_t dir_size) {
+  char word[CONFIG_LINE_SIZE];
+  struct cpu6502_device_range *device;
+  struct cpu6502_bank *bank;
+  uint16_t start, end;
+  uint32_t n, reg, base, count;
+  size_t page;
+  int rom = !strcmp(key, "rom");
+  if (!strcmp(key, "clock")) {
+    if (cpu6502_config_number(&value, &n) || cpu6502_config_end(value))
+      return cpu6502_config_fail(config, number, "bad clock rate");
+    config->clock_hz = n;
+  } else if (!strcmp(key, "cpu")) {
+    if (cpu6502_config_word(&value, word, sizeof(word)) ||
+        cpu6502_config_end(value))
+      return cpu6502_config_fail(config, number, "bad cpu variant");
+    if (!strcmp(word, "6502")) config->variant = CPU_VARIANT_NMOS;
+    /* It would run as an NMOS 6502, so don't pretend */
+    else if (!strcmp(word, "65c02"))
+      return cpu6502_config_fail(config, number, "65c02 isn't emulated");
+    else return cpu6502_config_fail(config, number, "unknown cpu variant");
+  } else if (!strcmp(key, "ram") || rom) {
+    if (cpu6502_config_range(&value, &start, &end))
+      return cpu6502_config_fail(config, number, "bad range");
+    if (start % PAGE_SIZE || (end + 1) % PAGE_SIZE)
+      return cpu6502_config_fail(config, number, "range isn't page aligned");
+    if (cpu6502_config_claim(config, start, end, CONFIG_CLAIM_MEMORY))
+      return cpu6502_config_fail(config, number, "range overlaps another");
+    for (page = start / PAGE_SIZE; page <= end / PAGE_SIZE; page++) {
+      config->page_flags[page] &= (uint8_t)~PAGE_FLAG_ROM;
+      if (rom) config->page_flags[page] |= PAGE_FLAG_ROM;
+    }
+    if (rom && !cpu6502_config_word(&value, word, sizeof(word)) &&
+        cpu6502_config_load_rom(config, dir, dir_size, word, start, end))
+      return cpu6502_config_fail(config, number, "bad rom file or size");
+    if (cpu6502_config_end(value))
+      return cpu6502_config_fail(config, number, "unexpected text after range");
+  } else if (!strcmp(key, "wait")) {
+    if (cpu6502_config_range(&value, &start, &end) ||
+        cpu6502_config_number(&value, &n) || n > UINT8_MAX ||
+        cpu6502_config_end(value))
+      return cpu6502_config_fail(config, number, "bad wait states");
+    for (page = start / PAGE_SIZE; page <= end / PAGE_SIZE; page++)
+      config->wait_states[page] = (uint8_t)n;
+  } else if (!strcmp(key, "device")) {
+    if (config->device_count == MAX_DEVICES)
+      return cpu6502_config_fail(config, number, "too many devices");
+    device = &config->devices[config->device_count];
+    if (cpu6502_config_word(&value, device->name, sizeof(device->name)) ||
+        cpu6502_config_range(&value, &device->start, &device->end) ||
+        cpu6502_config_end(value))
+      return cpu6502_config_fail(config, number, "bad device");
+    if (cpu6502_config_claim(
+          config, device->start, device->end, CONFIG_CLAIM_DEVICE))
+      return cpu6502_config_fail(config, number, "device overlaps memory");
+    for (page = device->start / PAGE_SIZE;
+        page <= device->end / PAGE_SIZE; page++) {
+      config->page_flags[page] &= (uint8_t)~PAGE_FLAG_ROM;
+      config->page_flags[page] |= PAGE_FLAG_IO;
+    }
+    config->device_count++;
+  } else if (!strcmp(key, "bank")) {
+    if (config->bank_count == MAX_BANKS)
+      return cpu6502_config_fail(config, number, "too many banks");
+    if (cpu6502_config_number(&value, &reg) || reg > 0xffff ||
+        cpu6502_config_range(&value, &start, &end) ||
+        cpu6502_config_number(&value, &base) ||
+        cpu6502_config_number(&value, &count) || count == 0 ||
+        cpu6502_config_end(value))
+      return cpu6502_config_fail(config, number, "bad bank");
+    if (start % PAGE_SIZE || (end + 1) % PAGE_SIZE || base % PAGE_SIZE)
+      return cpu6502_config_fail(config, number, "bank isn't page aligned");
+    /* Banks there would alias whatever the address space maps straight */
+    if (base < ADDR_PAGE_COUNT * PAGE_SIZE)
+      return cpu6502_config_fail(config, number, "banks overlap mapped RAM");
+    if ((uint64_t)base + (uint64_t)count * (end - start + 1u) > RAM_SIZE)
+      return cpu6502_config_fail(config, number, "banks don't fit in RAM");
+    if (cpu6502_config_claim(config, start, end, CONFIG_CLAIM_MEMORY))
+      return cpu6502_config_fail(config, number, "window overlaps another");
+    bank = &config->banks[config->bank_count++];
+    bank->reg = (uint16_t)reg;
+    bank->window = start;
+    bank->size = end - start + 1u;
+    bank->base = base;
+    bank->count = count;
+    /* The window starts out showing bank 0 */
+    for (page = 0; page < bank->size / PAGE_SIZE; page++) {
+      config->page_map[start / PAGE_SIZE + page] =
+        base + (uint32_t)(page * PAGE_SIZE);
+      config->page_flags[start / PAGE_SIZE + page] &= (uint8_t)~PAGE_FLAG_ROM;
+    }
+    config->page_flags[reg / PAGE_SIZE] |= PAGE_FLAG_BANK;
+  } else {
+    return cpu6502_config_fail(config, number, "unknown key");
+  }
+  return 0;
+}
+/* Parse a machine description file (0 on success, else see config->error) */
+static int cpu6502_config_parse(struct cpu6502_config *config, const char *path) {
+  char line[CONFIG_LINE_SIZE], *key, *value, *p;
+  const char *slash = strrchr(path, '/');
+  size_t dir_size = slash ? (size_t)(slash - path) + 1 : 0, i;
+  unsigned number = 0;
+  FILE *f;
+  int result = 0;
+  memset(config, 0, sizeof(*config));
+  /* Unclaimed pages ignore writes, and all pages start mapped straight */
+  for (i = 0; i < ADDR_PAGE_COUNT; i++) {
+    config->page_map[i] = (uint32_t)(i * PAGE_SIZE);
+    config->page_flags[i] = PAGE_FLAG_ROM;
+  }
+  f = fopen(path, "r");
+  if (!f) return cpu6502_config_fail(config, 0, "can't open file");
+  while (!result && fgets(line, sizeof(line), f)) {
+    number++;
+    if (!strchr(line, '\n') && !feof(f)) {
+      result = cpu6502_config_fail(config, number, "line too long");
+      break;
+    }
+    /* Strip comments and leading space */
+    line[strcspn(line, "#;")] = 0;
+    for (key = line; isspace((unsigned char)*key); key++);
+    if (!*key) continue;
+    value = strchr(key, '=');
+    if (!value) {
+      result = cpu6502_config_fail(config, number, "expected key = value");
+      break;
+    }
+    /* Split and trim the key */
+    *value++ = 0;
+    for (p = value - 1; p > key && isspace((unsigned char)p[-1]); p--);
+    *p = 0;
+    result = cpu6502_config_line(config, number, key, value, path, dir_size);
+  }
+  fclose(f);
+  return result;
+}
+/* Apply a parsed machine description's memory map to a machine */
+static void cpu6502_config_apply(
+    struct cpu6502 *cpu,
+    const struct cpu6502_config *config) {
+  size_t page;
+  memcpy(cpu->page_map, config->page_map, sizeof(cpu->page_map));
+  /* Tracing and write logging are the host's, like hooks, so they stay */
+  for (page = 0; page < ADDR_PAGE_COUNT; page++)
+    cpu->page_flags[page] = (uint8_t)(config->page_flags[page] |
+        (cpu->page_flags[page] & (PAGE_FLAG_TRACE | PAGE_FLAG_LOG)));
+  memcpy(cpu->wait_states, config->wait_states, sizeof(cpu->wait_states));
+  memcpy(cpu->banks, config->banks, sizeof(cpu->banks));
+  cpu->bank_count = config->bank_count;
+}
+/* Power on a machine as described, with its ROM loaded (0 on success) */
+static int cpu6502_config_power_on(
+    struct cpu6502 *cpu,
+    const struct cpu6502_config *config,
+    uint64_t pattern) {
+  size_t page;
+  cpu6502_power_on(cpu, pattern);
+  cpu6502_config_apply(cpu, config);
+  for (page = 0; page < ADDR_PAGE_COUNT; page++) {
+    /* Only ROM given in the description; unclaimed pages stay unallocated */
+    if (!(config->page_flags[page] & PAGE_FLAG_ROM) ||
+        config->claimed[page] != CONFIG_CLAIM_MEMORY)
+      continue;
+    if (cpu6502_store(cpu, config->page_map[page],
+          config->image + page * PAGE_SIZE, PAGE_SIZE))
+      return -1;
+  }
+  cpu6502_reset(cpu);
+  return 0;
+}
+
+#endif /* CPU6502_CONFIG_H */
@@ -0,0 +1,181 @@
+/* Include guard */
+#if !defined(CPU6502_DEVICES_H)
+#define CPU6502_DEVICES_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include "cpu6502.h"
+
+struct cpu6502_device;
+
+/* Bring a device's state up to a cycle */
+typedef void (*cpu6502_device_advance_fn)(
+    struct cpu6502_device *device, uint64_t cycle);
+/* Get the next cycle a device could raise an interrupt at, or UINT64_MAX */
+typedef uint64_t (*cpu6502_device_next_fn)(struct cpu6502_device *device);
+/* Read a register of a device, advanced to the cycle of the read */
+typedef uint8_t (*cpu6502_device_read_fn)(
+    struct cpu6502_device *device, uint16_t addr);
+/* Write a register of a device, advanced to the cycle of the write */
+typedef void (*cpu6502_device_write_fn)(
+    struct cpu6502_device *device, uint16_t addr, uint8_t value);
+
+/*
+ * A peripheral with registers in the address space.
+ * It is synchronized lazily: advanced only when its registers are
+ * accessed or the cycle next returned arrives (through the machine's due
+ * hook, so under any run loop), so code that doesn't touch it runs with
+ * no per-instruction cost for it. Its callbacks set irq while its IRQ
+ * output is asserted, which is combined with the other devices' onto the
+ * machine's IRQ line, and set nmi to signal an NMI edge.
+ */
+struct cpu6502_device {
+  uint16_t start;       /* Address of its first register */
+  uint16_t end;         /* Address of its last register */
+  cpu6502_device_advance_fn advance; /* Brings it up to a cycle */
+  cpu6502_device_next_fn next; /* Gets its next interrupt cycle, or NULL */
+  cpu6502_device_read_fn read; /* Reads a register, or NULL for 0xff */
+  cpu6502_device_write_fn write; /* Writes a register, or NULL to ignore */
+  void *ctx;            /* The device's own state */
+  uint64_t synced;      /* Cycle it has been advanced to */
+  uint64_t due;         /* Cycle it next has to be advanced at */
+  uint8_t irq;          /* Its IRQ output is asserted */
+  uint8_t nmi;          /* It has signalled an NMI */
+};
+
+/*
+ * The devices of a machine, wired to its I/O and due hooks.
+ * The devices drive the IRQ line between them, and the machine's due
+ * cycle is the earliest cycle any of them is due at.
+ */
+struct cpu6502_devices {
+  struct cpu6502 *cpu;  /* The machine */
+  struct cpu6502_device devices[MAX_DEVICES]; /* The devices */
+  size_t count;         /* Number of devices */
+};
+
+/* Find the device with a register at an address, or NULL */
+static struct cpu6502_device *cpu6502_devices_find(
+    struct cpu6502_devices *devs,
+    uint16_t addr) {
+  size_t i;
+  for (i = 0; i < devs->count; i++)
+    if (addr >= devs->devices[i].start && addr <= devs->devices[i].end)
+      return &devs->devices[i];
+  return NULL;
+}
+/* Advance a device to a cycle, and find when it is next due */
+static void cpu6502_devices_sync(
+    struct cpu6502_device *device,
+    uint64_t cycle) {
+  if (cycle > device->synced) {
+    device->advance(device, cycle);
+    device->synced = cycle;
+  }
+  device->due = device->next ? device->next(device) : UINT64_MAX;
+  /* A device can't be due again at the cycle it was advanced to */
+  if (device->due <= device->synced) device->due = device->synced + 1;
+}
+/* Pass the devices' interrupts to the machine, and set when one is due */
+static void cpu6502_devices_update(struct cpu6502_devices *devs) {
+  struct cpu6502_device *device;
+  uint64_t *due = &devs->cpu->hooks.due_cycle;
+  int irq = 0;
+  size_t i;
+  *due = UINT64_MAX;
+  for (i = 0; i < devs->count; i++) {
+    device = &devs->devices[i];
+    irq |= device->irq;
+    if (device->nmi) {
+      device->nmi = 0;
+      cpu6502_nmi(devs->cpu);
+    }
+    if (device->due < *due) *due = device->due;
+  }
+  cpu6502_irq(devs->cpu, irq);
+}
+/* I/O read hook, synchronizing the device read */
+static uint8_t cpu6502_devices_read(
+    struct cpu6502 *cpu,
+    uint16_t addr,
+    void *ctx) {
+  struct cpu6502_devices *devs = ctx;
+  struct cpu6502_device *device = cpu6502_devices_find(devs, addr);
+  uint8_t value;
+  /* Addresses no device claims on an I/O page are RAM */
+  if (!device) return cpu6502_peek(cpu, addr);
+  cpu6502_devices_sync(device, cpu->cycles);
+  value = device->read ? device->read(device, addr) : 0xff;
+  /* A read can acknowledge an interrupt, so look again */
+  cpu6502_devices_sync(device, cpu->cycles);
+  cpu6502_devices_update(devs);
+  return value;
+}
+/* I/O write hook, synchronizing the device written */
+static int cpu6502_devices_write(
+    struct cpu6502 *cpu,
+    uint16_t addr,
+    uint8_t value,
+    void *ctx) {
+  struct cpu6502_devices *devs = ctx;
+  struct cpu6502_device *device = cpu6502_devices_find(devs, addr);
+  if (!device) return 0;
+  cpu6502_devices_sync(device, cpu->cycles);
+  if (device->write) device->write(device, addr, value);
+  /* A write can start a timer or acknowledge an interrupt */
+  cpu6502_devices_sync(device, cpu->cycles);
+  cpu6502_devices_update(devs);
+  return 1;
+}
+/* Due hook, advancing the devices that have fallen due */
+static void cpu6502_devices_due(struct cpu6502 *cpu, void *ctx) {
+  struct cpu6502_devices *devs = ctx;
+  size_t i;
+  for (i = 0; i < devs->count; i++)
+    if (devs->devices[i].due <= cpu->cycles)
+      cpu6502_devices_sync(&devs->devices[i], cpu->cycles);
+  cpu6502_devices_update(devs);
+}
+/* Wire an empty set of devices to a machine's I/O and due hooks */
+static void cpu6502_devices_init(
+    struct cpu6502_devices *devs,
+    struct cpu6502 *cpu) {
+  devs->cpu = cpu;
+  devs->count = 0;
+  cpu->hooks.io_read = cpu6502_devices_read;
+  cpu->hooks.io_write = cpu6502_devices_write;
+  cpu->hooks.io_ctx = devs;
+  cpu->hooks.due = cpu6502_devices_due;
+  cpu->hooks.due_ctx = devs;
+  cpu->hooks.due_cycle = UINT64_MAX;
+}
+/* Add a device, flagging its pages as I/O (NULL if there are too many) */
+/* The copy added is returned; it starts at the machine's current cycle */
+static struct cpu6502_device *cpu6502_devices_add(
+    struct cpu6502_devices *devs,
+    const struct cpu6502_device *device) {
+  struct cpu6502_device *added;
+  size_t page;
+  if (devs->count == MAX_DEVICES || device->start > device->end) return NULL;
+  added = &devs->devices[devs->count++];
+  *added = *device;
+  added->synced = devs->cpu->cycles;
+  added->irq = 0;
+  added->nmi = 0;
+  for (page = added->start / PAGE_SIZE; page <= added->end / PAGE_SIZE; page++)
+    devs->cpu->page_flags[page] |= PAGE_FLAG_IO;
+  cpu6502_devices_sync(added, added->synced);
+  cpu6502_devices_update(devs);
+  return added;
+}
+/* Advance every device to the machine's current cycle */
+/* For when the host needs them all current, such as at the end of a frame */
+static void cpu6502_devices_sync_all(struct cpu6502_devices *devs) {
+  size_t i;
+  for (i = 0; i < devs->count; i++)
+    cpu6502_devices_sync(&devs->devices[i], devs->cpu->cycles);
+  cpu6502_devices_update(devs);
+}
+
+#endif /* CPU6502_DEVICES_H */
@@ -0,0 +1,125 @@
+/* Include guard */
+#if !defined(CPU6502_EVENTS_H)
+#define CPU6502_EVENTS_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/* Event callback, given its context and the cycle it was scheduled for */
+typedef void (*cpu6502_event_fn)(void *ctx, uint64_t cycle);
+
+/* An event, due at a cycle */
+struct cpu6502_event {
+  uint64_t cycle;           /* Cycle the event is due at */
+  cpu6502_event_fn fire;    /* Called when the event is due */
+  void *ctx;                /* Passed to the callback */
+};
+
+/* A device clock, running num device cycles for every den CPU cycles */
+struct cpu6502_clock {
+  uint64_t num;             /* Device cycles per period */
+  uint64_t den;             /* CPU cycles per period */
+};
+
+/* Event scheduler, a binary min-heap ordered by cycle */
+struct cpu6502_events {
+  struct cpu6502_event *heap; /* The pending events */
+  size_t count;               /* Number of pending events */
+  size_t capacity;            /* Maximum number of pending events */
+};
+
+/* Allocate an event scheduler for up to capacity events (0 on success) */
+static int cpu6502_events_init(struct cpu6502_events *events, size_t capacity) {
+  events->heap = malloc(capacity * sizeof(struct cpu6502_event));
+  if (!events->heap) return -1;
+  events->count = 0;
+  events->capacity = capacity;
+  return 0;
+}
+/* Free an event scheduler */
+static void cpu6502_events_free(struct cpu6502_events *events) {
+  free(events->heap);
+  events->heap = NULL;
+  events->count = 0;
+  events->capacity = 0;
+}
+/* Schedule an event at a cycle (0 on success, -1 if full) */
+static int cpu6502_events_schedule(
+    struct cpu6502_events *events,
+    uint64_t cycle,
+    cpu6502_event_fn fire,
+    void *ctx) {
+  struct cpu6502_event event;
+  size_t i, parent;
+  if (events->count == events->capacity) return -1;
+  event.cycle = cycle;
+  event.fire = fire;
+  event.ctx = ctx;
+  /* Sift up from the new leaf */
+  for (i = events->count++; i > 0; i = parent) {
+    parent = (i - 1) / 2;
+    if (events->heap[parent].cycle <= cycle) break;
+    events->heap[i] = events->heap[parent];
+  }
+  events->heap[i] = event;
+  return 0;
+}
+/* Convert a device cycle to the first CPU cycle at or after it */
+static uint64_t cpu6502_clock_to_cpu(
+    const struct cpu6502_clock *clock,
+    uint64_t cycle) {
+  /* Whole periods first, so large cycle counts can't overflow */
+  return cycle / clock->num * clock->den +
+    (cycle % clock->num * clock->den + clock->num - 1) / clock->num;
+}
+/* Convert a CPU cycle to the last device cycle at or before it */
+static uint64_t cpu6502_clock_to_device(
+    const struct cpu6502_clock *clock,
+    uint64_t cycle) {
+  return cycle / clock->den * clock->num +
+    cycle % clock->den * clock->num / clock->den;
+}
+/* Schedule an event at a cycle of a device's clock (0 on success) */
+static int cpu6502_events_schedule_clocked(
+    struct cpu6502_events *events,
+    const struct cpu6502_clock *clock,
+    uint64_t device_cycle,
+    cpu6502_event_fn fire,
+    void *ctx) {
+  return cpu6502_events_schedule(
+      events, cpu6502_clock_to_cpu(clock, device_cycle), fire, ctx);
+}
+/* Get the cycle of the next event, or UINT64_MAX if there is none */
+static uint64_t cpu6502_events_next(const struct cpu6502_events *events) {
+  return events->count ? events->heap[0].cycle : UINT64_MAX;
+}
+/* Remove the next event from the heap */
+static struct cpu6502_event cpu6502_events_pop(struct cpu6502_events *events) {
+  struct cpu6502_event top = events->heap[0];
+  struct cpu6502_event last = events->heap[--events->count];
+  size_t i = 0, child;
+  /* Sift the last leaf down from the root */
+  while ((child = 2 * i + 1) < events->count) {
+    if (child + 1 < events->count &&
+        events->heap[child + 1].cycle < events->heap[child].cycle)
+      child++;
+    if (last.cycle <= events->heap[child].cycle) break;
+    events->heap[i] = events->heap[child];
+    i = child;
+  }
+  if (events->count) events->heap[i] = last;
+  return top;
+}
+/* Fire every event due at or before a cycle, in order */
+static void cpu6502_events_run(struct cpu6502_events *events, uint64_t cycle) {
+  struct cpu6502_event event;
+  while (events->count && events->heap[0].cycle <= cycle) {
+    /* Pop first, so the callback can schedule more events */
+    event = cpu6502_events_pop(events);
+    event.fire(event.ctx, event.cycle);
+  }
+}
+
+#endif /* CPU6502_EVENTS_H */
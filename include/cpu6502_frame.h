@@ -0,0 +1,111 @@
+/* Include guard */
+#if !defined(CPU6502_FRAME_H)
+#define CPU6502_FRAME_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include "cpu6502.h"
+#include "cpu6502_events.h"
+
+/* Interrupt raised at the start of vblank */
+enum vblank_interrupts_6502 {
+  VBLANK_INTERRUPT_NONE=0,  /* Nothing is raised */
+  VBLANK_INTERRUPT_NMI=1,   /* An NMI is signalled */
+  VBLANK_INTERRUPT_IRQ=2,   /* The IRQ line is asserted, for the host to release */
+};
+
+/* Called at the start of each scanline */
+typedef void (*cpu6502_scanline_fn)(struct cpu6502 *cpu, unsigned line, void *ctx);
+
+/* Frame timing of a video-style host */
+struct cpu6502_frame_config {
+  uint64_t cycles_per_line;     /* Number of cycles in a scanline */
+  unsigned lines;               /* Number of scanlines in a frame */
+  unsigned vblank_line;         /* Scanline vblank starts at */
+  enum vblank_interrupts_6502 vblank; /* Interrupt raised at vblank */
+  cpu6502_scanline_fn scanline; /* Called each scanline, or NULL */
+  void *ctx;                    /* Passed to the scanline callback */
+};
+
+/* What happened during one frame */
+struct cpu6502_frame_stats {
+  uint64_t frame;               /* Number of the frame, from 0 */
+  uint64_t start_cycle;         /* Cycle the frame started at */
+  uint64_t cycles;              /* Number of cycles run */
+  unsigned lines;               /* Number of scanlines started */
+  unsigned vblanks;             /* Number of vblank interrupts raised */
+};
+
+/* Runs a machine a frame at a time */
+struct cpu6502_frame {
+  struct cpu6502 *cpu;          /* The machine */
+  struct cpu6502_frame_config config; /* Frame timing */
+  struct cpu6502_events events; /* Scanline and vblank events */
+  struct cpu6502_frame_stats stats; /* The frame being run */
+  uint64_t frames;              /* Number of frames run */
+};
+
+/* Set up a machine to run a frame at a time (0 on success) */
+static int cpu6502_frame_init(
+    struct cpu6502_frame *frame,
+    struct cpu6502 *cpu,
+    const struct cpu6502_frame_config *config) {
+  frame->cpu = cpu;
+  frame->config = *config;
+  frame->frames = 0;
+  /* At most the next scanline and vblank are pending */
+  return cpu6502_events_init(&frame->events, 2);
+}
+/* Free a frame runner (but not its machine) */
+static void cpu6502_frame_free(struct cpu6502_frame *frame) {
+  cpu6502_events_free(&frame->events);
+}
+/* Event: start of vblank */
+static void cpu6502_frame_vblank(void *ctx, uint64_t cycle) {
+  struct cpu6502_frame *frame = ctx;
+  (void)cycle;
+  switch (frame->config.vblank) {
+    case VBLANK_INTERRUPT_NMI: cpu6502_nmi(frame->cpu); break;
+    case VBLANK_INTERRUPT_IRQ: cpu6502_irq(frame->cpu, 1); break;
+    default: return;
+  }
+  frame->stats.vblanks++;
+}
+/* Event: start of a scanline, scheduling the next one */
+static void cpu6502_frame_line(void *ctx, uint64_t cycle) {
+  struct cpu6502_frame *frame = ctx;
+  unsigned line = frame->stats.lines++;
+  if (frame->config.scanline)
+    frame->config.scanline(frame->cpu, line, frame->config.ctx);
+  if (line + 1 < frame->config.lines)
+    cpu6502_events_schedule(&frame->events,
+        cycle + frame->config.cycles_per_line, cpu6502_frame_line, frame);
+}
+/* Run the machine to the end of the next frame, returning what happened */
+static struct cpu6502_frame_stats cpu6502_run_frame(struct cpu6502_frame *frame) {
+  struct cpu6502 *cpu = frame->cpu;
+  uint64_t start = cpu->cycles, end, next;
+  end = start + frame->config.cycles_per_line * frame->config.lines;
+  frame->stats.frame = frame->frames++;
+  frame->stats.start_cycle = start;
+  frame->stats.lines = 0;
+  frame->stats.vblanks = 0;
+  cpu6502_events_schedule(&frame->events, start, cpu6502_frame_line, frame);
+  if (frame->config.vblank_line < frame->config.lines)
+    cpu6502_events_schedule(&frame->events,
+        start + frame->config.cycles_per_line * frame->config.vblank_line,
+        cpu6502_frame_vblank, frame);
+  /* Run flat out between events, with no bookkeeping per instruction */
+  for (;;) {
+    cpu6502_events_run(&frame->events, cpu->cycles);
+    next = cpu6502_events_next(&frame->events);
+    if (next > end) next = end;
+    if (cpu->cycles >= end) break;
+    cpu6502_run(cpu, next);
+  }
+  frame->stats.cycles = cpu->cycles - start;
+  return frame->stats;
+}
+
+#endif /* CPU6502_FRAME_H */
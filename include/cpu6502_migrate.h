@@ -0,0 +1,217 @@
+/* Include guard */
+#if !defined(CPU6502_MIGRATE_H)
+#define CPU6502_MIGRATE_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu6502.h"
+#include "cpu6502_snapshot.h"
+
+/* Constants */
+#define MIGRATE_MAGIC 0x3147494d32303536ull /* "6502MIG1" */
+
+/* Records in a migration stream */
+enum migrate_records_6502 {
+  MIGRATE_RECORD_END=0,     /* End of the stream */
+  MIGRATE_RECORD_PAGE=1,    /* Page number, then the page */
+  MIGRATE_RECORD_FREE=2,    /* Block number of a block holding the pattern */
+};
+
+/*
+ * Stop-and-copy migration between processes sharing a base image.
+ * The machine is sent in one pass while it is stopped, so it is down for
+ * the whole transfer; there are no rounds of sending pages dirtied while
+ * it keeps running.
+ * The stream is a header (magic, the size of a machine, and the size and
+ * hash of the image), the registers and tables compressed as in a
+ * snapshot, then a record for each block or page that differs from the
+ * image: the receiver loads the image, frees the blocks the sender
+ * hasn't allocated, and overwrites the pages the sender changed. Dirty
+ * pages are sent as they are; clean ones are compared with the image, as
+ * RAM needn't have come from it (cpu6502_store doesn't dirty pages, and
+ * a machine powered on with a pattern never held it). Any FILE works,
+ * such as a pipe or a socket opened with fdopen. Both ends must be the
+ * same build.
+ */
+/* Write a little-endian integer (0 on success) */
+static int cpu6502_migrate_put(FILE *out, uint64_t value, size_t bytes) {
+  uint8_t buf[8];
+  size_t i;
+  for (i = 0; i < bytes; i++)
+    buf[i] = (uint8_t)(value >> (8 * i));
+  return fwrite(buf, 1, bytes, out) == bytes ? 0 : -1;
+}
+/* Read a little-endian integer (0 on success) */
+static int cpu6502_migrate_get(FILE *in, uint64_t *value, size_t bytes) {
+  uint8_t buf[8];
+  size_t i;
+  if (fread(buf, 1, bytes, in) != bytes) return -1;
+  *value = 0;
+  for (i = 0; i < bytes; i++)
+    *value |= (uint64_t)buf[i] << (8 * i);
+  return 0;
+}
+/* Hash an image, so both ends can check they share it */
+static uint64_t cpu6502_migrate_hash(const uint8_t *image, size_t size) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  size_t i;
+  for (i = 0; i < size; i++)
+    hash = (hash ^ image[i]) * 0x100000001b3ull;
+  return hash;
+}
+/* Write the registers and tables, compressed (0 on success) */
+static int cpu6502_migrate_send_registers(const struct cpu6502 *cpu, FILE *out) {
+  const size_t head = cpu6502_snapshot_head(), tail = cpu6502_snapshot_tail();
+  const size_t regs = head + sizeof(struct cpu6502) - tail;
+  uint8_t *raw = malloc(regs), *packed = malloc(cpu6502_compress_bound(regs));
+  size_t size;
+  int result = -1;
+  if (raw && packed) {
+    memcpy(raw, cpu, head);
+    memcpy(raw + head, (const uint8_t *)cpu + tail, sizeof(struct cpu6502) - tail);
+    size = cpu6502_compress(packed, raw, regs);
+    if (!cpu6502_migrate_put(out, size, 4) &&
+        fwrite(packed, 1, size, out) == size)
+      result = 0;
+  }
+  free(raw);
+  free(packed);
+  return result;
+}
+/* Check whether a page of RAM differs from the image, or the pattern past it */
+static int cpu6502_migrate_changed(
+    const struct cpu6502 *cpu,
+    size_t page,
+    const uint8_t *image,
+    size_t image_size) {
+  const uint8_t *data = cpu->read_blocks[page / 64] + page % 64 * PAGE_SIZE;
+  size_t offset = page * PAGE_SIZE, n;
+  /* The part of the page covered by the image */
+  n = offset < image_size ? image_size - offset : 0;
+  if (n > PAGE_SIZE) n = PAGE_SIZE;
+  return memcmp(data, image + offset, n) ||
+    memcmp(data + n, cpu->fill_block + (offset + n) % BLOCK_SIZE, PAGE_SIZE - n);
+}
+/* Stream a machine sharing an image to another process (0 on success) */
+static int cpu6502_migrate_send(
+    const struct cpu6502 *cpu,
+    FILE *out,
+    const uint8_t *image,
+    size_t image_size) {
+  size_t block, bit;
+  if (image_size > RAM_SIZE) image_size = RAM_SIZE;
+  if (cpu6502_migrate_put(out, MIGRATE_MAGIC, 8) ||
+      cpu6502_migrate_put(out, sizeof(struct cpu6502), 4) ||
+      cpu6502_migrate_put(out, image_size, 8) ||
+      cpu6502_migrate_put(out, cpu6502_migrate_hash(image, image_size), 8) ||
+      cpu6502_migrate_send_registers(cpu, out))
+    return -1;
+  for (block = 0; block < BLOCK_COUNT; block++) {
+    /* A block not allocated holds only the pattern, where loading the */
+    /* image would have put the image */
+    if (!cpu->blocks[block]) {
+      if (block * BLOCK_SIZE >= image_size) continue;
+      if (cpu6502_migrate_put(out, MIGRATE_RECORD_FREE, 1) ||
+          cpu6502_migrate_put(out, block, 4))
+        return -1;
+      continue;
+    }
+    for (bit = 0; bit < 64; bit++) {
+      if (!(cpu->dirty[block] & ((uint64_t)1 << bit)) &&
+          !cpu6502_migrate_changed(cpu, block * 64 + bit, image, image_size))
+        continue;
+      if (cpu6502_migrate_put(out, MIGRATE_RECORD_PAGE, 1) ||
+          cpu6502_migrate_put(out, block * 64 + bit, 4) ||
+          fwrite(cpu->blocks[block] + bit * PAGE_SIZE, 1, PAGE_SIZE, out) !=
+            PAGE_SIZE)
+        return -1;
+    }
+  }
+  if (cpu6502_migrate_put(out, MIGRATE_RECORD_END, 1)) return -1;
+  return fflush(out) ? -1 : 0;
+}
+/* Apply the page records of a stream, up to its end (0 on success) */
+static int cpu6502_migrate_records(struct cpu6502 *cpu, FILE *in) {
+  uint64_t type, number;
+  uint8_t *block;
+  for (;;) {
+    if (cpu6502_migrate_get(in, &type, 1)) return -1;
+    if (type == MIGRATE_RECORD_END) return 0;
+    if (cpu6502_migrate_get(in, &number, 4)) return -1;
+    if (type == MIGRATE_RECORD_FREE && number < BLOCK_COUNT) {
+      cpu6502_free_block(cpu, number);
+    } else if (type == MIGRATE_RECORD_PAGE && number < PAGE_COUNT) {
+      block = cpu6502_alloc_block(cpu, number / 64);
+      if (!block ||
+          fread(block + number % 64 * PAGE_SIZE, 1, PAGE_SIZE, in) != PAGE_SIZE)
+        return -1;
+    } else {
+      return -1;
+    }
+  }
+}
+/* Read the registers and tables into raw, which holds them (0 on success) */
+static int cpu6502_migrate_receive_registers(
+    uint8_t *raw,
+    size_t regs,
+    FILE *in) {
+  uint64_t size;
+  uint8_t *packed;
+  int result = -1;
+  if (cpu6502_migrate_get(in, &size, 4) ||
+      size > cpu6502_compress_bound(regs))
+    return -1;
+  packed = malloc(size ? size : 1);
+  if (packed && fread(packed, 1, size, in) == size)
+    result = cpu6502_decompress(raw, regs, packed, size);
+  free(packed);
+  return result;
+}
+/* Resume a machine set up with cpu6502_init from a stream (0 on success) */
+static int cpu6502_migrate_receive(
+    struct cpu6502 *cpu,
+    FILE *in,
+    const uint8_t *image,
+    size_t image_size) {
+  const size_t head = cpu6502_snapshot_head(), tail = cpu6502_snapshot_tail();
+  const size_t regs = head + sizeof(struct cpu6502) - tail;
+  uint64_t magic, size, base_size, hash;
+  struct cpu6502_hooks hooks;
+  uint8_t *raw;
+  if (image_size > RAM_SIZE) image_size = RAM_SIZE;
+  if (cpu6502_migrate_get(in, &magic, 8) ||
+      cpu6502_migrate_get(in, &size, 4) ||
+      cpu6502_migrate_get(in, &base_size, 8) ||
+      cpu6502_migrate_get(in, &hash, 8) ||
+      magic != MIGRATE_MAGIC || size != sizeof(struct cpu6502) ||
+      base_size != image_size ||
+      hash != cpu6502_migrate_hash(image, image_size))
+    return -1;
+  raw = malloc(regs);
+  if (!raw) return -1;
+  if (cpu6502_migrate_receive_registers(raw, regs, in)) {
+    free(raw);
+    return -1;
+  }
+  /* The pattern first, so the image is loaded over the sender's */
+  memcpy(cpu->fill_block,
+      raw + head + offsetof(struct cpu6502, fill_block) - tail, BLOCK_SIZE);
+  if (cpu6502_load(cpu, image, image_size) ||
+      cpu6502_migrate_records(cpu, in)) {
+    free(raw);
+    return -1;
+  }
+  /* Everything else, including the dirty pages */
+  hooks = cpu->hooks;
+  memcpy(cpu, raw, head);
+  memcpy((uint8_t *)cpu + tail, raw + head, sizeof(struct cpu6502) - tail);
+  cpu->hooks = hooks;
+  free(raw);
+  return 0;
+}
+
+#endif /* CPU6502_MIGRATE_H */
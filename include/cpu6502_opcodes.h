@@ -0,0 +1,395 @@
+/* Include guard */
+#if !defined(CPU6502_OPCODES_H)
+#define CPU6502_OPCODES_H
+
+/*
+ * The instruction set, shared by the C core and the C++ wrapper.
+ * Plain enums and macros only, so it compiles as either language.
+ */
+
+/* Addressing modes */
+enum addressing_modes_6502 {
+  ADDR_MODE_ACCUMULATOR=0,  /* The value in a */
+  ADDR_MODE_ABSOLUTE=1,     /* The value at immediate address */
+  ADDR_MODE_ABSOLUTE_X=2,   /* the value at immediate address + x */
+  ADDR_MODE_ABSOLUTE_Y=3,   /* the value at immediate address + y */
+  ADDR_MODE_IMMEDIATE=4,    /* The immediate value */
+  ADDR_MODE_IMPLIED=5,      /* No value needed or value implied by instruction */
+  ADDR_MODE_INDIRECT=6,     /* The value at address at immediate address */
+  ADDR_MODE_INDIRECT_X=7,   /* The value at address at (immediate address + x) */
+  ADDR_MODE_INDIRECT_Y=8,   /* (The value at address at immediate address) + y */
+  ADDR_MODE_RELATIVE=9,     /* The value is the program counter + immediate */
+  ADDR_MODE_ZERO_PAGE=10,   /* The value at immediate address in zero page */
+  ADDR_MODE_ZERO_PAGE_X=11, /* The value at immediate address in zero page + x */
+  ADDR_MODE_ZERO_PAGE_Y=12, /* The value at immediate address in zero page + y */
+  ADDR_MODE_NONE=13,        /* Empty space in instruction set */
+};
+/* Instruction types */
+enum instr_types_6502 {
+  /* Load/store */
+  INSTR_TYPE_LDA=0,         /* Load accumulator */
+  INSTR_TYPE_LDX=1,         /* Load X register */
+  INSTR_TYPE_LDY=2,         /* Load Y register */
+  INSTR_TYPE_STA=3,         /* Store accumulator */
+  INSTR_TYPE_STX=4,         /* Store X register */
+  INSTR_TYPE_STY=5,         /* Store Y register */
+  /* Register transfers */
+  INSTR_TYPE_TAX=6,         /* Transfer accumulator to X */
+  INSTR_TYPE_TAY=7,         /* Transfer accumulator to Y */
+  INSTR_TYPE_TXA=8,         /* Transfer X to accumulator */
+  INSTR_TYPE_TYA=9,         /* Transfer Y to accumulator */
+  /* Stack operations */
+  INSTR_TYPE_TSX=10,        /* Transfer stack pointer to X */
+  INSTR_TYPE_TXS=11,        /* Transfer X to stack pointer */
+  INSTR_TYPE_PHA=12,        /* Push accumulator */
+  INSTR_TYPE_PHP=13,        /* Push status register */
+  INSTR_TYPE_PLA=14,        /* Pop accumulator */
+  INSTR_TYPE_PLP=15,        /* Pop status register */
+  /* Logical */
+  INSTR_TYPE_AND=16,        /* Logical AND */
+  INSTR_TYPE_EOR=17,        /* Exclusive OR */
+  INSTR_TYPE_ORA=18,        /* Logical OR */
+  INSTR_TYPE_BIT=19,        /* Bit test */
+  /* Arithmetic */
+  INSTR_TYPE_ADC=20,        /* Add with carry */
+  INSTR_TYPE_SBC=21,        /* Subtract with carry */
+  INSTR_TYPE_CMP=22,        /* Compare to accumulator */
+  INSTR_TYPE_CPX=23,        /* Compare to X register */
+  INSTR_TYPE_CPY=24,        /* Compare to Y register */
+  /* Increments & Decrements */
+  INSTR_TYPE_INC=25,        /* Increment memory */
+  INSTR_TYPE_INX=26,        /* Increment X register */
+  INSTR_TYPE_INY=27,        /* Increment Y register */
+  INSTR_TYPE_DEC=28,        /* Decrement memory */
+  INSTR_TYPE_DEX=29,        /* Decrement X register */
+  INSTR_TYPE_DEY=30,        /* Decrement Y register */
+  /* Shifts */
+  INSTR_TYPE_ASL=31,        /* Arithmetic shift left */
+  INSTR_TYPE_LSR=32,        /* Logical shift right */
+  INSTR_TYPE_ROL=33,        /* Rotate left */
+  INSTR_TYPE_ROR=34,        /* Rotate right */
+  /* Jumps & calls */
+  INSTR_TYPE_JMP=35,        /* Jump to address */
+  INSTR_TYPE_JSR=36,        /* Jump to subroutine */
+  INSTR_TYPE_RTS=37,        /* Return from subroutine */
+  /* Branches */
+  INSTR_TYPE_BCC=38,        /* Branch on carry clear */
+  INSTR_TYPE_BCS=39,        /* Branch on carry set */
+  INSTR_TYPE_BEQ=40,        /* Branch on zero set */
+  INSTR_TYPE_BMI=41,        /* Branch on result minus */
+  INSTR_TYPE_BNE=42,        /* Branch on zero clear */
+  INSTR_TYPE_BPL=43,        /* Branch on result positive */
+  INSTR_TYPE_BVC=44,        /* Branch on overflow clear */
+  INSTR_TYPE_BVS=45,        /* Branch on overflow set */
+  /* Status flag changes */
+  INSTR_TYPE_CLC=46,        /* Clear carry flag */
+  INSTR_TYPE_CLD=47,        /* Clear decimal flag */
+  INSTR_TYPE_CLI=48,        /* Clear interrupt disable flag */
+  INSTR_TYPE_CLV=49,        /* Clear overflow flag */
+  INSTR_TYPE_SEC=50,        /* Set carry flag */
+  INSTR_TYPE_SED=51,        /* Set decimal flag */
+  INSTR_TYPE_SEI=52,        /* Set interrupt disable flag */
+  /* System functions */
+  INSTR_TYPE_BRK=53,        /* Force interrupt */
+  INSTR_TYPE_NOP=54,        /* No operation */
+  INSTR_TYPE_RTI=55,        /* Return from interrupt */
+  /* None */
+  INSTR_TYPE_NONE=56,       /* Empty space in instruction set */
+};
+
+/* Status register flags */
+enum status_flags_6502 {
+  STATUS_FLAG_C=1,          /* Carry flag */
+  STATUS_FLAG_Z=2,          /* Zero flag */
+  STATUS_FLAG_I=4,          /* Interrupt disable flag */
+  STATUS_FLAG_D=8,          /* Decimal flag */
+  STATUS_FLAG_B=16,         /* Break flag */
+  STATUS_FLAG_U=32,         /* Unused flag */
+  STATUS_FLAG_V=64,         /* Overflow flag */
+  STATUS_FLAG_N=128,        /* Negative flag */
+};
+
+/* Status flags an instruction may change, as named in the opcode list */
+#define AFFECTS_NONE        0
+#define AFFECTS_C           STATUS_FLAG_C
+#define AFFECTS_D           STATUS_FLAG_D
+#define AFFECTS_I           STATUS_FLAG_I
+#define AFFECTS_V           STATUS_FLAG_V
+#define AFFECTS_NZ          (STATUS_FLAG_N|STATUS_FLAG_Z)
+#define AFFECTS_NZC         (STATUS_FLAG_N|STATUS_FLAG_Z|STATUS_FLAG_C)
+#define AFFECTS_NVZ         (STATUS_FLAG_N|STATUS_FLAG_V|STATUS_FLAG_Z)
+#define AFFECTS_NVZC        (STATUS_FLAG_N|STATUS_FLAG_V|STATUS_FLAG_Z|STATUS_FLAG_C)
+#define AFFECTS_ALL         0xcf
+
+/*
+ * The instruction set, one opcode per line:
+ * OPCODE(opcode, mnemonic, addressing mode, cycles, flags affected, heat)
+ * The mnemonic names the instruction type and the mode names the
+ * addressing mode, without their INSTR_TYPE_ and ADDR_MODE_ prefixes.
+ * Cycles are the base count, before page crossings, taken branches and
+ * wait states. Flags name an AFFECTS_ constant. Heat is HOT, WARM or
+ * COLD, for how often typical programs run the opcode, and decides where
+ * its handler is placed. Unused opcodes are NONE, and run as 1 byte,
+ * 2 cycle NOPs.
+ * The decode tables, handlers and disassembler are all generated from
+ * this list, so it is the one place an opcode is described.
+ */
+#define CPU6502_OPCODES(OPCODE) \
+  OPCODE(0x00, BRK, IMPLIED, 7, I, COLD)        \
+  OPCODE(0x01, ORA, INDIRECT_X, 6, NZ, WARM)    \
+  OPCODE(0x02, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x03, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x04, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x05, ORA, ZERO_PAGE, 3, NZ, WARM)     \
+  OPCODE(0x06, ASL, ZERO_PAGE, 5, NZC, WARM)    \
+  OPCODE(0x07, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x08, PHP, IMPLIED, 3, NONE, WARM)     \
+  OPCODE(0x09, ORA, IMMEDIATE, 2, NZ, HOT)      \
+  OPCODE(0x0a, ASL, ACCUMULATOR, 2, NZC, HOT)   \
+  OPCODE(0x0b, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x0c, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x0d, ORA, ABSOLUTE, 4, NZ, WARM)      \
+  OPCODE(0x0e, ASL, ABSOLUTE, 6, NZC, WARM)     \
+  OPCODE(0x0f, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x10, BPL, RELATIVE, 2, NONE, HOT)     \
+  OPCODE(0x11, ORA, INDIRECT_Y, 5, NZ, WARM)    \
+  OPCODE(0x12, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x13, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x14, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x15, ORA, ZERO_PAGE_X, 4, NZ, WARM)   \
+  OPCODE(0x16, ASL, ZERO_PAGE_X, 6, NZC, WARM)  \
+  OPCODE(0x17, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x18, CLC, IMPLIED, 2, C, HOT)         \
+  OPCODE(0x19, ORA, ABSOLUTE_Y, 4, NZ, WARM)    \
+  OPCODE(0x1a, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x1b, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x1c, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x1d, ORA, ABSOLUTE_X, 4, NZ, WARM)    \
+  OPCODE(0x1e, ASL, ABSOLUTE_X, 7, NZC, WARM)   \
+  OPCODE(0x1f, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x20, JSR, ABSOLUTE, 6, NONE, HOT)     \
+  OPCODE(0x21, AND, INDIRECT_X, 6, NZ, WARM)    \
+  OPCODE(0x22, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x23, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x24, BIT, ZERO_PAGE, 3, NVZ, WARM)    \
+  OPCODE(0x25, AND, ZERO_PAGE, 3, NZ, WARM)     \
+  OPCODE(0x26, ROL, ZERO_PAGE, 5, NZC, WARM)    \
+  OPCODE(0x27, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x28, PLP, IMPLIED, 4, ALL, WARM)      \
+  OPCODE(0x29, AND, IMMEDIATE, 2, NZ, HOT)      \
+  OPCODE(0x2a, ROL, ACCUMULATOR, 2, NZC, HOT)   \
+  OPCODE(0x2b, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x2c, BIT, ABSOLUTE, 4, NVZ, WARM)     \
+  OPCODE(0x2d, AND, ABSOLUTE, 4, NZ, WARM)      \
+  OPCODE(0x2e, ROL, ABSOLUTE, 6, NZC, WARM)     \
+  OPCODE(0x2f, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x30, BMI, RELATIVE, 2, NONE, HOT)     \
+  OPCODE(0x31, AND, INDIRECT_Y, 5, NZ, WARM)    \
+  OPCODE(0x32, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x33, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x34, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x35, AND, ZERO_PAGE_X, 4, NZ, WARM)   \
+  OPCODE(0x36, ROL, ZERO_PAGE_X, 6, NZC, WARM)  \
+  OPCODE(0x37, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x38, SEC, IMPLIED, 2, C, HOT)         \
+  OPCODE(0x39, AND, ABSOLUTE_Y, 4, NZ, WARM)    \
+  OPCODE(0x3a, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x3b, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x3c, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x3d, AND, ABSOLUTE_X, 4, NZ, WARM)    \
+  OPCODE(0x3e, ROL, ABSOLUTE_X, 7, NZC, WARM)   \
+  OPCODE(0x3f, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x40, RTI, IMPLIED, 6, ALL, COLD)      \
+  OPCODE(0x41, EOR, INDIRECT_X, 6, NZ, WARM)    \
+  OPCODE(0x42, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x43, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x44, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x45, EOR, ZERO_PAGE, 3, NZ, WARM)     \
+  OPCODE(0x46, LSR, ZERO_PAGE, 5, NZC, WARM)    \
+  OPCODE(0x47, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x48, PHA, IMPLIED, 3, NONE, HOT)      \
+  OPCODE(0x49, EOR, IMMEDIATE, 2, NZ, WARM)     \
+  OPCODE(0x4a, LSR, ACCUMULATOR, 2, NZC, HOT)   \
+  OPCODE(0x4b, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x4c, JMP, ABSOLUTE, 3, NONE, HOT)     \
+  OPCODE(0x4d, EOR, ABSOLUTE, 4, NZ, WARM)      \
+  OPCODE(0x4e, LSR, ABSOLUTE, 6, NZC, WARM)     \
+  OPCODE(0x4f, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x50, BVC, RELATIVE, 2, NONE, WARM)    \
+  OPCODE(0x51, EOR, INDIRECT_Y, 5, NZ, WARM)    \
+  OPCODE(0x52, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x53, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x54, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x55, EOR, ZERO_PAGE_X, 4, NZ, WARM)   \
+  OPCODE(0x56, LSR, ZERO_PAGE_X, 6, NZC, WARM)  \
+  OPCODE(0x57, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x58, CLI, IMPLIED, 2, I, WARM)        \
+  OPCODE(0x59, EOR, ABSOLUTE_Y, 4, NZ, WARM)    \
+  OPCODE(0x5a, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x5b, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x5c, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x5d, EOR, ABSOLUTE_X, 4, NZ, WARM)    \
+  OPCODE(0x5e, LSR, ABSOLUTE_X, 7, NZC, WARM)   \
+  OPCODE(0x5f, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x60, RTS, IMPLIED, 6, NONE, HOT)      \
+  OPCODE(0x61, ADC, INDIRECT_X, 6, NVZC, WARM)  \
+  OPCODE(0x62, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x63, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x64, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x65, ADC, ZERO_PAGE, 3, NVZC, HOT)    \
+  OPCODE(0x66, ROR, ZERO_PAGE, 5, NZC, WARM)    \
+  OPCODE(0x67, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x68, PLA, IMPLIED, 4, NZ, HOT)        \
+  OPCODE(0x69, ADC, IMMEDIATE, 2, NVZC, HOT)    \
+  OPCODE(0x6a, ROR, ACCUMULATOR, 2, NZC, HOT)   \
+  OPCODE(0x6b, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x6c, JMP, INDIRECT, 5, NONE, WARM)    \
+  OPCODE(0x6d, ADC, ABSOLUTE, 4, NVZC, WARM)    \
+  OPCODE(0x6e, ROR, ABSOLUTE, 6, NZC, WARM)     \
+  OPCODE(0x6f, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x70, BVS, RELATIVE, 2, NONE, WARM)    \
+  OPCODE(0x71, ADC, INDIRECT_Y, 5, NVZC, WARM)  \
+  OPCODE(0x72, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x73, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x74, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x75, ADC, ZERO_PAGE_X, 4, NVZC, WARM) \
+  OPCODE(0x76, ROR, ZERO_PAGE_X, 6, NZC, WARM)  \
+  OPCODE(0x77, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x78, SEI, IMPLIED, 2, I, WARM)        \
+  OPCODE(0x79, ADC, ABSOLUTE_Y, 4, NVZC, WARM)  \
+  OPCODE(0x7a, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x7b, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x7c, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x7d, ADC, ABSOLUTE_X, 4, NVZC, WARM)  \
+  OPCODE(0x7e, ROR, ABSOLUTE_X, 7, NZC, WARM)   \
+  OPCODE(0x7f, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x80, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x81, STA, INDIRECT_X, 6, NONE, WARM)  \
+  OPCODE(0x82, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x83, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x84, STY, ZERO_PAGE, 3, NONE, HOT)    \
+  OPCODE(0x85, STA, ZERO_PAGE, 3, NONE, HOT)    \
+  OPCODE(0x86, STX, ZERO_PAGE, 3, NONE, HOT)    \
+  OPCODE(0x87, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x88, DEY, IMPLIED, 2, NZ, HOT)        \
+  OPCODE(0x89, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x8a, TXA, IMPLIED, 2, NZ, HOT)        \
+  OPCODE(0x8b, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x8c, STY, ABSOLUTE, 4, NONE, WARM)    \
+  OPCODE(0x8d, STA, ABSOLUTE, 4, NONE, HOT)     \
+  OPCODE(0x8e, STX, ABSOLUTE, 4, NONE, WARM)    \
+  OPCODE(0x8f, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x90, BCC, RELATIVE, 2, NONE, HOT)     \
+  OPCODE(0x91, STA, INDIRECT_Y, 6, NONE, HOT)   \
+  OPCODE(0x92, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x93, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x94, STY, ZERO_PAGE_X, 4, NONE, WARM) \
+  OPCODE(0x95, STA, ZERO_PAGE_X, 4, NONE, WARM) \
+  OPCODE(0x96, STX, ZERO_PAGE_Y, 4, NONE, WARM) \
+  OPCODE(0x97, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x98, TYA, IMPLIED, 2, NZ, HOT)        \
+  OPCODE(0x99, STA, ABSOLUTE_Y, 5, NONE, HOT)   \
+  OPCODE(0x9a, TXS, IMPLIED, 2, NONE, WARM)     \
+  OPCODE(0x9b, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x9c, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x9d, STA, ABSOLUTE_X, 5, NONE, HOT)   \
+  OPCODE(0x9e, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0x9f, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xa0, LDY, IMMEDIATE, 2, NZ, HOT)      \
+  OPCODE(0xa1, LDA, INDIRECT_X, 6, NZ, WARM)    \
+  OPCODE(0xa2, LDX, IMMEDIATE, 2, NZ, HOT)      \
+  OPCODE(0xa3, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xa4, LDY, ZERO_PAGE, 3, NZ, HOT)      \
+  OPCODE(0xa5, LDA, ZERO_PAGE, 3, NZ, HOT)      \
+  OPCODE(0xa6, LDX, ZERO_PAGE, 3, NZ, HOT)      \
+  OPCODE(0xa7, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xa8, TAY, IMPLIED, 2, NZ, HOT)        \
+  OPCODE(0xa9, LDA, IMMEDIATE, 2, NZ, HOT)      \
+  OPCODE(0xaa, TAX, IMPLIED, 2, NZ, HOT)        \
+  OPCODE(0xab, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xac, LDY, ABSOLUTE, 4, NZ, WARM)      \
+  OPCODE(0xad, LDA, ABSOLUTE, 4, NZ, HOT)       \
+  OPCODE(0xae, LDX, ABSOLUTE, 4, NZ, WARM)      \
+  OPCODE(0xaf, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xb0, BCS, RELATIVE, 2, NONE, HOT)     \
+  OPCODE(0xb1, LDA, INDIRECT_Y, 5, NZ, HOT)     \
+  OPCODE(0xb2, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xb3, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xb4, LDY, ZERO_PAGE_X, 4, NZ, WARM)   \
+  OPCODE(0xb5, LDA, ZERO_PAGE_X, 4, NZ, WARM)   \
+  OPCODE(0xb6, LDX, ZERO_PAGE_Y, 4, NZ, WARM)   \
+  OPCODE(0xb7, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xb8, CLV, IMPLIED, 2, V, WARM)        \
+  OPCODE(0xb9, LDA, ABSOLUTE_Y, 4, NZ, HOT)     \
+  OPCODE(0xba, TSX, IMPLIED, 2, NZ, WARM)       \
+  OPCODE(0xbb, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xbc, LDY, ABSOLUTE_X, 4, NZ, WARM)    \
+  OPCODE(0xbd, LDA, ABSOLUTE_X, 4, NZ, HOT)     \
+  OPCODE(0xbe, LDX, ABSOLUTE_Y, 4, NZ, WARM)    \
+  OPCODE(0xbf, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xc0, CPY, IMMEDIATE, 2, NZC, HOT)     \
+  OPCODE(0xc1, CMP, INDIRECT_X, 6, NZC, WARM)   \
+  OPCODE(0xc2, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xc3, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xc4, CPY, ZERO_PAGE, 3, NZC, WARM)    \
+  OPCODE(0xc5, CMP, ZERO_PAGE, 3, NZC, HOT)     \
+  OPCODE(0xc6, DEC, ZERO_PAGE, 5, NZ, HOT)      \
+  OPCODE(0xc7, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xc8, INY, IMPLIED, 2, NZ, HOT)        \
+  OPCODE(0xc9, CMP, IMMEDIATE, 2, NZC, HOT)     \
+  OPCODE(0xca, DEX, IMPLIED, 2, NZ, HOT)        \
+  OPCODE(0xcb, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xcc, CPY, ABSOLUTE, 4, NZC, WARM)     \
+  OPCODE(0xcd, CMP, ABSOLUTE, 4, NZC, HOT)      \
+  OPCODE(0xce, DEC, ABSOLUTE, 6, NZ, WARM)      \
+  OPCODE(0xcf, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xd0, BNE, RELATIVE, 2, NONE, HOT)     \
+  OPCODE(0xd1, CMP, INDIRECT_Y, 5, NZC, WARM)   \
+  OPCODE(0xd2, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xd3, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xd4, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xd5, CMP, ZERO_PAGE_X, 4, NZC, WARM)  \
+  OPCODE(0xd6, DEC, ZERO_PAGE_X, 6, NZ, WARM)   \
+  OPCODE(0xd7, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xd8, CLD, IMPLIED, 2, D, COLD)        \
+  OPCODE(0xd9, CMP, ABSOLUTE_Y, 4, NZC, WARM)   \
+  OPCODE(0xda, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xdb, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xdc, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xdd, CMP, ABSOLUTE_X, 4, NZC, WARM)   \
+  OPCODE(0xde, DEC, ABSOLUTE_X, 7, NZ, WARM)    \
+  OPCODE(0xdf, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xe0, CPX, IMMEDIATE, 2, NZC, HOT)     \
+  OPCODE(0xe1, SBC, INDIRECT_X, 6, NVZC, WARM)  \
+  OPCODE(0xe2, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xe3, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xe4, CPX, ZERO_PAGE, 3, NZC, WARM)    \
+  OPCODE(0xe5, SBC, ZERO_PAGE, 3, NVZC, WARM)   \
+  OPCODE(0xe6, INC, ZERO_PAGE, 5, NZ, HOT)      \
+  OPCODE(0xe7, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xe8, INX, IMPLIED, 2, NZ, HOT)        \
+  OPCODE(0xe9, SBC, IMMEDIATE, 2, NVZC, HOT)    \
+  OPCODE(0xea, NOP, IMPLIED, 2, NONE, WARM)     \
+  OPCODE(0xeb, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xec, CPX, ABSOLUTE, 4, NZC, WARM)     \
+  OPCODE(0xed, SBC, ABSOLUTE, 4, NVZC, WARM)    \
+  OPCODE(0xee, INC, ABSOLUTE, 6, NZ, WARM)      \
+  OPCODE(0xef, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xf0, BEQ, RELATIVE, 2, NONE, HOT)     \
+  OPCODE(0xf1, SBC, INDIRECT_Y, 5, NVZC, WARM)  \
+  OPCODE(0xf2, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xf3, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xf4, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xf5, SBC, ZERO_PAGE_X, 4, NVZC, WARM) \
+  OPCODE(0xf6, INC, ZERO_PAGE_X, 6, NZ, WARM)   \
+  OPCODE(0xf7, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xf8, SED, IMPLIED, 2, D, COLD)        \
+  OPCODE(0xf9, SBC, ABSOLUTE_Y, 4, NVZC, WARM)  \
+  OPCODE(0xfa, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xfb, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xfc, NONE, NONE, 2, NONE, COLD)       \
+  OPCODE(0xfd, SBC, ABSOLUTE_X, 4, NVZC, WARM)  \
+  OPCODE(0xfe, INC, ABSOLUTE_X, 7, NZ, WARM)    \
+  OPCODE(0xff, NONE, NONE, 2, NONE, COLD)
+
+#endif /* CPU6502_OPCODES_H */
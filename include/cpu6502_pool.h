@@ -0,0 +1,152 @@
+/* Include guard */
+#if !defined(CPU6502_POOL_H)
+#define CPU6502_POOL_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu6502.h"
+
+/* Counters for one pooled machine, written only by the thread holding it */
+struct cpu6502_pool_stats {
+  _Alignas(CACHE_LINE_SIZE)
+  uint64_t acquires;        /* Times the machine was handed out */
+  uint64_t releases;        /* Times the machine was given back */
+  uint64_t pages_restored;  /* Dirty pages restored on release */
+};
+
+/*
+ * Pool of pre-allocated machines, reused with a fast reset.
+ * A machine's RAM is first touched when it is first acquired, so the OS
+ * places its pages on the NUMA node of the acquiring thread. Give each
+ * worker thread its own pool to keep its machines on its node.
+ */
+struct cpu6502_pool {
+  struct cpu6502 *machines; /* The machines, allocated once */
+  uint8_t *powered;         /* Whether each machine has been powered on */
+  struct cpu6502_pool_stats *stats; /* Counters for each machine */
+  size_t *free_list;        /* Indices of machines not handed out */
+  size_t free_count;        /* Number of entries in the free list */
+  size_t count;             /* Number of machines */
+  const uint8_t *image;     /* Initial RAM image, loaded at address 0 */
+  size_t image_size;        /* Size of the initial RAM image, in bytes */
+};
+
+/* Allocate a pool of machines, without touching their RAM (0 on success) */
+static int cpu6502_pool_init(
+    struct cpu6502_pool *pool,
+    size_t count,
+    const uint8_t *image,
+    size_t image_size) {
+  size_t i;
+  /* Both are whole cache lines in size, as aligned_alloc requires */
+  pool->machines = aligned_alloc(
+      CACHE_LINE_SIZE, count * sizeof(struct cpu6502));
+  pool->stats = aligned_alloc(
+      CACHE_LINE_SIZE, count * sizeof(struct cpu6502_pool_stats));
+  pool->free_list = malloc(count * sizeof(size_t));
+  pool->powered = calloc(count, 1);
+  if (!pool->machines || !pool->stats || !pool->free_list || !pool->powered) {
+    free(pool->machines);
+    free(pool->stats);
+    free(pool->free_list);
+    free(pool->powered);
+    return -1;
+  }
+  memset(pool->stats, 0, count * sizeof(struct cpu6502_pool_stats));
+  pool->count = count;
+  pool->image = image;
+  pool->image_size = image_size;
+  /* Hand out the lowest indices first */
+  for (i = 0; i < count; i++)
+    pool->free_list[i] = count - 1 - i;
+  pool->free_count = count;
+  return 0;
+}
+/* Free a pool and all of its machines */
+static void cpu6502_pool_free(struct cpu6502_pool *pool) {
+  size_t i;
+  for (i = 0; i < pool->count; i++)
+    if (pool->powered[i]) cpu6502_free(&pool->machines[i]);
+  free(pool->machines);
+  free(pool->stats);
+  free(pool->free_list);
+  free(pool->powered);
+  pool->machines = NULL;
+  pool->stats = NULL;
+  pool->free_list = NULL;
+  pool->powered = NULL;
+  pool->count = 0;
+  pool->free_count = 0;
+}
+/* Take a reset machine from the pool, or NULL if all are in use */
+static struct cpu6502 *cpu6502_pool_acquire(struct cpu6502_pool *pool) {
+  size_t i;
+  if (pool->free_count == 0) return NULL;
+  i = pool->free_list[--pool->free_count];
+  /* First use: power on from this thread, so its pages are local to it */
+  if (!pool->powered[i]) {
+    cpu6502_init(&pool->machines[i]);
+    if (cpu6502_load(&pool->machines[i], pool->image, pool->image_size)) {
+      cpu6502_free(&pool->machines[i]);
+      pool->free_count++;
+      return NULL;
+    }
+    cpu6502_reset(&pool->machines[i]);
+    pool->powered[i] = 1;
+  }
+  pool->stats[i].acquires++;
+  return &pool->machines[i];
+}
+/* Check a machine's RAM is still the image apart from its dirty pages */
+/* (not so once powered on or loaded again, which frees its blocks) */
+static int cpu6502_pool_intact(
+    const struct cpu6502_pool *pool,
+    const struct cpu6502 *cpu) {
+  static const uint8_t zeros[8] = { 0 };
+  size_t block, size = pool->image_size;
+  if (size > RAM_SIZE) size = RAM_SIZE;
+  if (memcmp(cpu->fill_block, zeros, sizeof(zeros))) return 0;
+  for (block = 0; block < (size + BLOCK_SIZE - 1) / BLOCK_SIZE; block++)
+    if (!cpu->blocks[block]) return 0;
+  return 1;
+}
+/* Give a machine back to the pool, as it was when first powered on */
+/* Only its dirty pages are copied back, unless the job replaced its RAM */
+/* Everything else, such as hooks, cycles and the address space, is reset */
+/* (RAM a job changed with cpu6502_store isn't dirty, so isn't restored) */
+static void cpu6502_pool_release(
+    struct cpu6502_pool *pool,
+    struct cpu6502 *cpu) {
+  size_t i = (size_t)(cpu - pool->machines);
+  if (cpu6502_pool_intact(pool, cpu)) {
+    pool->stats[i].pages_restored +=
+      cpu6502_restore(cpu, pool->image, pool->image_size);
+  } else {
+    cpu6502_power_on(cpu, 0);
+    /* Out of memory: power it on again from scratch when next acquired */
+    if (cpu6502_load(cpu, pool->image, pool->image_size)) {
+      cpu6502_free(cpu);
+      pool->powered[i] = 0;
+    }
+  }
+  cpu6502_power_on_registers(cpu);
+  pool->stats[i].releases++;
+  pool->free_list[pool->free_count++] = i;
+}
+/* Sum the counters of every machine in the pool */
+static struct cpu6502_pool_stats cpu6502_pool_stats(
+    const struct cpu6502_pool *pool) {
+  struct cpu6502_pool_stats total = { 0 };
+  size_t i;
+  for (i = 0; i < pool->count; i++) {
+    total.acquires += pool->stats[i].acquires;
+    total.releases += pool->stats[i].releases;
+    total.pages_restored += pool->stats[i].pages_restored;
+  }
+  return total;
+}
+
+#endif /* CPU6502_POOL_H */
@@ -0,0 +1,97 @@
+/* Include guard */
+#if !defined(CPU6502_RUNAHEAD_H)
+#define CPU6502_RUNAHEAD_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "cpu6502.h"
+
+/* Applies a frame's host input to a machine (through cpu6502_write) */
+typedef void (*cpu6502_input_fn)(struct cpu6502 *cpu, uint32_t input, void *ctx);
+
+/*
+ * Run-ahead for interactive machines.
+ * After each frame a spare copy of the machine speculatively runs the
+ * next frame, predicting the input stays the same. If the real input
+ * matches, the spare's state is copied into the primary and the frame is
+ * already done; otherwise it is discarded and the frame is run for real.
+ * Only machines without I/O can run ahead: with no io_read, io_write or
+ * due hook, the spare computes exactly what the primary would, and nothing
+ * outside the machine needs saving with it. The spare has no hooks, and
+ * the primary keeps its own (such as a branch or write hook) and its
+ * address across adoptions.
+ * Each copy between the two looks only at pages written since the last
+ * one. After changing the primary other than by running it, such as
+ * loading or restoring a snapshot, set up run-ahead again.
+ * The speculation touches only the spare, so the host can run
+ * cpu6502_runahead_speculate on another core while it waits for input,
+ * as long as it finishes before the next cpu6502_runahead_frame.
+ */
+struct cpu6502_runahead {
+  struct cpu6502 *primary;      /* The machine the host sees */
+  struct cpu6502 *spare;        /* The machine run ahead speculatively */
+  cpu6502_input_fn apply_input; /* Applies input before a frame */
+  void *ctx;                    /* Passed to apply_input */
+  uint64_t frame_cycles;        /* Number of cycles in a frame */
+  uint32_t predicted;           /* Input the spare was run ahead with */
+  int ready;                    /* Whether the spare holds the next frame */
+  uint64_t hits;                /* Frames adopted from the spare */
+  uint64_t misses;              /* Frames run again after a misprediction */
+};
+
+/* Check a machine has no I/O, which would make the spare's frames differ */
+static int cpu6502_runahead_isolated(const struct cpu6502 *cpu) {
+  return !cpu->hooks.io_read && !cpu->hooks.io_write && !cpu->hooks.due;
+}
+/* Set up run-ahead of a machine, with an initialised spare (0 on success) */
+/* Fails for a machine with I/O */
+static int cpu6502_runahead_init(
+    struct cpu6502_runahead *ra,
+    struct cpu6502 *primary,
+    struct cpu6502 *spare,
+    uint64_t frame_cycles,
+    cpu6502_input_fn apply_input,
+    void *ctx) {
+  ra->primary = primary;
+  ra->spare = spare;
+  ra->apply_input = apply_input;
+  ra->ctx = ctx;
+  ra->frame_cycles = frame_cycles;
+  ra->predicted = 0;
+  ra->ready = 0;
+  ra->hits = 0;
+  ra->misses = 0;
+  if (!cpu6502_runahead_isolated(primary)) return -1;
+  /* One full copy; after this only pages written are copied */
+  return cpu6502_clone(spare, primary);
+}
+/* Run the spare a frame ahead of the primary, with the last input */
+static void cpu6502_runahead_speculate(struct cpu6502_runahead *ra) {
+  /* I/O attached since, or out of memory: the next frame runs normally */
+  if (!cpu6502_runahead_isolated(ra->primary) ||
+      cpu6502_copy(ra->spare, ra->primary))
+    return;
+  ra->apply_input(ra->spare, ra->predicted, ra->ctx);
+  cpu6502_run(ra->spare, ra->spare->cycles + ra->frame_cycles);
+  ra->ready = 1;
+}
+/* Run a frame with the real input, adopting the spare if it predicted it */
+static void cpu6502_runahead_frame(struct cpu6502_runahead *ra, uint32_t input) {
+  /* The spare already ran this frame; only pages written are copied */
+  /* (out of memory leaves the primary as it was, to run the frame itself) */
+  if (ra->ready && input == ra->predicted &&
+      !cpu6502_copy(ra->primary, ra->spare)) {
+    ra->hits++;
+  } else {
+    ra->apply_input(ra->primary, input, ra->ctx);
+    cpu6502_run(ra->primary, ra->primary->cycles + ra->frame_cycles);
+    if (ra->ready) ra->misses++;
+  }
+  /* The next frame is predicted to have the same input */
+  ra->predicted = input;
+  ra->ready = 0;
+}
+
+#endif /* CPU6502_RUNAHEAD_H */
@@ -0,0 +1,422 @@
+/* Include guard */
+#if !defined(CPU6502_SCHED_H)
+#define CPU6502_SCHED_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cpu6502.h"
+#include "cpu6502_events.h"
+#include "cpu6502_snapshot.h"
+
+/* CPU time limits need the per-thread CPU clock, a POSIX feature */
+/* (build with -D_POSIX_C_SOURCE=200809L or later, as the Makefile does) */
+#if !defined(CLOCK_THREAD_CPUTIME_ID)
+#error "cpu6502_sched.h needs CLOCK_THREAD_CPUTIME_ID: define _POSIX_C_SOURCE"
+#endif
+
+/* Constants */
+#define SCHED_CLASS_COUNT 2
+#define LATENCY_BUCKETS 32
+
+/* Priority classes */
+enum sched_classes_6502 {
+  SCHED_CLASS_INTERACTIVE=0, /* Short slices, run first in each round */
+  SCHED_CLASS_BATCH=1,       /* Long slices, to amortize switching */
+};
+
+struct cpu6502_sched;
+
+/* What a machine may use, or has used (a limit of 0 means no limit) */
+struct cpu6502_limits {
+  uint64_t cycles;              /* Emulated cycles */
+  double cpu_seconds;           /* Host thread CPU time, in seconds */
+  size_t memory;                /* RAM, snapshots and caches, in bytes */
+  uint64_t output;              /* Output, in bytes */
+};
+
+/* A machine multiplexed onto the scheduler's thread */
+struct cpu6502_task {
+  struct cpu6502 *cpu;          /* The machine */
+  struct cpu6502_sched *sched;  /* The scheduler running it */
+  size_t slot;                  /* Position in the runnable list */
+  int parked;                   /* Whether the machine is parked */
+  struct cpu6502_limits limits; /* What the machine may use */
+  struct cpu6502_limits used;   /* What the machine has used */
+  size_t extra_memory;          /* Memory charged besides RAM, in bytes */
+  size_t swapped_memory;        /* Size of the swapped out state, in bytes */
+  /* Why the machine was stopped for good, or STOP_REASON_NONE */
+  enum stop_reasons_6502 stop_reason;
+  enum sched_classes_6502 priority; /* Priority class */
+  double ready;                 /* Host time the machine was last ready */
+  /* The machine's state while it is swapped out, with its RAM freed */
+  struct cpu6502_snapshot swapped;
+};
+
+/*
+ * A priority class and its adaptive slice.
+ * A class with a latency target halves its slice after a round in which
+ * one of its machines waited longer than the target, and doubles it
+ * after a round well under it. A class without one grows its slice
+ * unless another class missed its target.
+ */
+struct cpu6502_sched_class {
+  uint64_t min_slice;           /* Shortest slice, in cycles */
+  uint64_t max_slice;           /* Longest slice, in cycles */
+  double latency_target;        /* Longest wait for a turn in seconds, or 0 */
+  uint64_t slice;               /* Current slice, in cycles */
+  double worst;                 /* Longest wait this round, in seconds */
+  /* Waits for a turn, bucket b counting those under 2^b microseconds */
+  uint64_t latency[LATENCY_BUCKETS];
+  uint64_t samples;             /* Number of waits counted */
+};
+
+/*
+ * Cooperative scheduler, running many machines on one host thread.
+ * Machines run in rounds, interactive machines first, each for a slice
+ * of its class. A round is as long as the shortest slice, so a machine
+ * with a longer slice runs ahead and sits out rounds until the rest
+ * catch up. A machine spinning in an idle loop is parked and skipped
+ * until an event wakes it, so idle machines cost nothing per turn.
+ */
+struct cpu6502_sched {
+  struct cpu6502_task *tasks;   /* The machines */
+  size_t count;                 /* Number of machines */
+  size_t capacity;              /* Maximum number of machines */
+  size_t *runnable;             /* Indices of machines not parked */
+  size_t runnable_count;        /* Number of machines not parked */
+  struct cpu6502_events events; /* Wake-ups and other timed events */
+  uint64_t now;                 /* Cycle every machine has been run up to */
+  struct cpu6502_sched_class classes[SCHED_CLASS_COUNT]; /* Priority classes */
+};
+
+/* Get the host's wall clock time, in seconds */
+static double cpu6502_sched_time(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+/* Get the host CPU time used by the calling thread, in seconds */
+/* Not clock(), which counts every thread of the process */
+static double cpu6502_sched_cpu_time(void) {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts)) return 0;
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Configure a priority class (slices are at least a cycle) */
+static void cpu6502_sched_set_class(
+    struct cpu6502_sched *sched,
+    enum sched_classes_6502 priority,
+    uint64_t min_slice,
+    uint64_t max_slice,
+    double latency_target) {
+  struct cpu6502_sched_class *cls = &sched->classes[priority];
+  /* An empty slice would end every round where it began */
+  if (min_slice == 0) min_slice = 1;
+  if (max_slice < min_slice) max_slice = min_slice;
+  cls->min_slice = min_slice;
+  cls->max_slice = max_slice;
+  cls->latency_target = latency_target;
+  cls->slice = latency_target > 0 ? min_slice : max_slice;
+}
+/* Allocate a scheduler for up to capacity machines (0 on success) */
+static int cpu6502_sched_init(
+    struct cpu6502_sched *sched,
+    size_t capacity,
+    uint64_t slice,
+    size_t max_events) {
+  size_t priority;
+  sched->tasks = malloc(capacity * sizeof(struct cpu6502_task));
+  sched->runnable = malloc(capacity * sizeof(size_t));
+  if (!sched->tasks || !sched->runnable ||
+      cpu6502_events_init(&sched->events, max_events)) {
+    free(sched->tasks);
+    free(sched->runnable);
+    return -1;
+  }
+  sched->count = 0;
+  sched->capacity = capacity;
+  sched->runnable_count = 0;
+  sched->now = 0;
+  /* Every class starts with the same fixed slice */
+  memset(sched->classes, 0, sizeof(sched->classes));
+  for (priority = 0; priority < SCHED_CLASS_COUNT; priority++)
+    cpu6502_sched_set_class(sched, priority, slice, slice, 0);
+  return 0;
+}
+/* Free a scheduler (but not its machines, which lose RAM if swapped out) */
+static void cpu6502_sched_free(struct cpu6502_sched *sched) {
+  size_t i;
+  for (i = 0; i < sched->count; i++)
+    cpu6502_snapshot_free(&sched->tasks[i].swapped);
+  free(sched->tasks);
+  free(sched->runnable);
+  cpu6502_events_free(&sched->events);
+  sched->tasks = NULL;
+  sched->runnable = NULL;
+  sched->count = 0;
+  sched->runnable_count = 0;
+}
+/* Add a runnable machine, returning its index (or -1 if full) */
+static long cpu6502_sched_add(struct cpu6502_sched *sched, struct cpu6502 *cpu) {
+  struct cpu6502_task *task;
+  if (sched->count == sched->capacity) return -1;
+  task = &sched->tasks[sched->count];
+  task->cpu = cpu;
+  task->sched = sched;
+  task->parked = 0;
+  memset(&task->limits, 0, sizeof(task->limits));
+  memset(&task->used, 0, sizeof(task->used));
+  task->extra_memory = 0;
+  task->swapped_memory = 0;
+  task->stop_reason = STOP_REASON_NONE;
+  task->priority = SCHED_CLASS_BATCH;
+  task->ready = cpu6502_sched_time();
+  task->swapped.data = NULL;
+  task->slot = sched->runnable_count;
+  sched->runnable[sched->runnable_count++] = sched->count;
+  return (long)sched->count++;
+}
+/* Park a machine, so it isn't run until woken */
+static void cpu6502_sched_park(struct cpu6502_sched *sched, size_t index) {
+  struct cpu6502_task *task = &sched->tasks[index];
+  size_t last;
+  if (task->parked) return;
+  /* Swap the last runnable machine into its slot */
+  last = sched->runnable[--sched->runnable_count];
+  sched->runnable[task->slot] = last;
+  sched->tasks[last].slot = task->slot;
+  task->parked = 1;
+}
+/* Swap a parked machine in, if it was swapped out (0 on success) */
+static int cpu6502_sched_swap_in(struct cpu6502_sched *sched, size_t index) {
+  struct cpu6502_task *task = &sched->tasks[index];
+  if (!task->swapped.data) return 0;
+  if (cpu6502_snapshot_restore(task->cpu, &task->swapped)) return -1;
+  task->swapped_memory = 0;
+  cpu6502_snapshot_free(&task->swapped);
+  return 0;
+}
+/* Wake a parked machine, skipping the cycles it spent idle */
+/* A machine that can't be swapped back in stays parked */
+static void cpu6502_sched_wake(struct cpu6502_sched *sched, size_t index) {
+  struct cpu6502_task *task = &sched->tasks[index];
+  if (!task->parked || task->stop_reason != STOP_REASON_NONE) return;
+  if (cpu6502_sched_swap_in(sched, index)) return;
+  if (task->cpu->cycles < sched->now) task->cpu->cycles = sched->now;
+  task->ready = cpu6502_sched_time();
+  task->slot = sched->runnable_count;
+  sched->runnable[sched->runnable_count++] = index;
+  task->parked = 0;
+}
+/* Event callback waking a task */
+static void cpu6502_sched_wake_event(void *ctx, uint64_t cycle) {
+  struct cpu6502_task *task = ctx;
+  cpu6502_sched_wake(task->sched, (size_t)(task - task->sched->tasks));
+  /* Resume from when the event was due, not the start of the turn */
+  if (task->cpu->cycles < cycle) task->cpu->cycles = cycle;
+}
+/* Wake a machine through the event scheduler at a cycle (0 on success) */
+static int cpu6502_sched_wake_at(
+    struct cpu6502_sched *sched,
+    size_t index,
+    uint64_t cycle) {
+  return cpu6502_events_schedule(
+      &sched->events, cycle, cpu6502_sched_wake_event, &sched->tasks[index]);
+}
+/*
+ * Swap parked machines out, least recently run first, until the RAM held
+ * by parked machines fits a budget. Each is compressed to a snapshot and
+ * its RAM freed; waking it swaps it back in. Returns how many were
+ * swapped out.
+ */
+static size_t cpu6502_sched_swap(struct cpu6502_sched *sched, size_t budget) {
+  struct cpu6502_task *task, *lru;
+  size_t i, held = 0, swapped = 0, ram;
+  for (i = 0; i < sched->count; i++)
+    if (sched->tasks[i].parked)
+      held += cpu6502_ram_allocated(sched->tasks[i].cpu);
+  while (held > budget) {
+    lru = NULL;
+    for (i = 0; i < sched->count; i++) {
+      task = &sched->tasks[i];
+      if (!task->parked || task->swapped.data ||
+          !cpu6502_ram_allocated(task->cpu))
+        continue;
+      if (!lru || task->ready < lru->ready) lru = task;
+    }
+    if (!lru || cpu6502_snapshot_take(&lru->swapped, lru->cpu)) break;
+    ram = cpu6502_ram_allocated(lru->cpu);
+    cpu6502_free(lru->cpu);
+    lru->swapped_memory = lru->swapped.size;
+    held -= ram;
+    swapped++;
+  }
+  return swapped;
+}
+/* Put a machine in a priority class */
+static void cpu6502_sched_set_priority(
+    struct cpu6502_sched *sched,
+    size_t index,
+    enum sched_classes_6502 priority) {
+  sched->tasks[index].priority = priority;
+}
+/* Count how long a machine waited for its turn */
+static void cpu6502_sched_record_wait(
+    struct cpu6502_sched_class *cls,
+    double wait) {
+  uint64_t us = wait > 0 ? (uint64_t)(wait * 1e6) : 0;
+  size_t bucket = 0;
+  while (us && bucket < LATENCY_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  cls->latency[bucket]++;
+  cls->samples++;
+  if (wait > cls->worst) cls->worst = wait;
+}
+/* Get a percentile (0-100) of a class's waits, in seconds (0 if none) */
+static double cpu6502_sched_latency(
+    const struct cpu6502_sched *sched,
+    enum sched_classes_6502 priority,
+    double percentile) {
+  const struct cpu6502_sched_class *cls = &sched->classes[priority];
+  uint64_t rank, seen = 0;
+  size_t bucket;
+  if (!cls->samples) return 0;
+  rank = (uint64_t)(percentile / 100 * (double)cls->samples);
+  if (rank >= cls->samples) rank = cls->samples - 1;
+  /* The upper bound of the bucket holding the sample at that rank */
+  for (bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+    seen += cls->latency[bucket];
+    if (seen > rank) break;
+  }
+  return (double)((uint64_t)1 << bucket) / 1e6;
+}
+/* Resize each class's slice after a round */
+static void cpu6502_sched_adapt(struct cpu6502_sched *sched) {
+  struct cpu6502_sched_class *cls;
+  size_t priority;
+  int missed = 0;
+  for (priority = 0; priority < SCHED_CLASS_COUNT; priority++) {
+    cls = &sched->classes[priority];
+    if (cls->latency_target > 0 && cls->worst > cls->latency_target)
+      missed = 1;
+  }
+  for (priority = 0; priority < SCHED_CLASS_COUNT; priority++) {
+    cls = &sched->classes[priority];
+    if (cls->latency_target > 0 ? cls->worst > cls->latency_target : missed)
+      cls->slice /= 2;
+    else if (cls->latency_target <= 0 || cls->worst < cls->latency_target / 2)
+      cls->slice *= 2;
+    if (cls->slice < cls->min_slice) cls->slice = cls->min_slice;
+    if (cls->slice > cls->max_slice) cls->slice = cls->max_slice;
+    cls->worst = 0;
+  }
+}
+/* Set what a machine may use */
+static void cpu6502_sched_limit(
+    struct cpu6502_sched *sched,
+    size_t index,
+    const struct cpu6502_limits *limits) {
+  sched->tasks[index].limits = *limits;
+}
+/* Charge a machine for output it produced */
+static void cpu6502_sched_charge_output(
+    struct cpu6502_sched *sched,
+    size_t index,
+    uint64_t bytes) {
+  sched->tasks[index].used.output += bytes;
+}
+/* Set the memory a machine holds besides its RAM, such as snapshots */
+/* Its own state while swapped out is charged separately, by the scheduler */
+static void cpu6502_sched_charge_memory(
+    struct cpu6502_sched *sched,
+    size_t index,
+    size_t bytes) {
+  sched->tasks[index].extra_memory = bytes;
+}
+/* Stop a machine for good if it is over a limit, returning why */
+static enum stop_reasons_6502 cpu6502_sched_check_limits(
+    struct cpu6502_sched *sched,
+    size_t index) {
+  struct cpu6502_task *task = &sched->tasks[index];
+  const struct cpu6502_limits *limits = &task->limits;
+  const struct cpu6502_limits *used = &task->used;
+  enum stop_reasons_6502 reason = STOP_REASON_NONE;
+  if (limits->cycles && used->cycles >= limits->cycles)
+    reason = STOP_REASON_CYCLE_LIMIT;
+  else if (limits->cpu_seconds > 0 && used->cpu_seconds >= limits->cpu_seconds)
+    reason = STOP_REASON_CPU_TIME;
+  else if (limits->memory && used->memory > limits->memory)
+    reason = STOP_REASON_MEMORY;
+  else if (limits->output && used->output > limits->output)
+    reason = STOP_REASON_OUTPUT;
+  if (reason != STOP_REASON_NONE) {
+    cpu6502_sched_park(sched, index);
+    task->stop_reason = reason;
+  }
+  return reason;
+}
+/* Run every runnable machine for a number of cycles */
+static void cpu6502_sched_run(struct cpu6502_sched *sched, uint64_t cycles) {
+  uint64_t end = sched->now + cycles, round_end, until, next, start;
+  struct cpu6502_sched_class *cls;
+  struct cpu6502_task *task;
+  struct cpu6502 *cpu;
+  size_t priority, i, index;
+  double now, cpu_start;
+  while (sched->now < end) {
+    cpu6502_events_run(&sched->events, sched->now);
+    next = cpu6502_events_next(&sched->events);
+    /* A round ends after the shortest slice, or at the next event */
+    round_end = UINT64_MAX;
+    for (priority = 0; priority < SCHED_CLASS_COUNT; priority++)
+      if (sched->now + sched->classes[priority].slice < round_end)
+        round_end = sched->now + sched->classes[priority].slice;
+    if (round_end > end) round_end = end;
+    if (round_end > next) round_end = next;
+    for (priority = 0; priority < SCHED_CLASS_COUNT; priority++) {
+      cls = &sched->classes[priority];
+      /* Backwards, so parking (which swaps in the last slot) skips no one */
+      for (i = sched->runnable_count; i-- > 0;) {
+        index = sched->runnable[i];
+        task = &sched->tasks[index];
+        cpu = task->cpu;
+        /* Still ahead from a longer slice */
+        if (task->priority != priority || cpu->cycles >= round_end) continue;
+        until = cpu->cycles + cls->slice;
+        if (until < round_end) until = round_end;
+        if (until > end) until = end;
+        if (until > next) until = next;
+        now = cpu6502_sched_time();
+        cpu6502_sched_record_wait(cls, now - task->ready);
+        start = cpu->cycles;
+        cpu_start = cpu6502_sched_cpu_time();
+        while (cpu->cycles < until) {
+          if (cpu6502_idle(cpu)) {
+            cpu6502_sched_park(sched, index);
+            break;
+          }
+          cpu6502_step(cpu);
+        }
+        task->ready = cpu6502_sched_time();
+        /* Limits are only checked here, between turns */
+        task->used.cycles += cpu->cycles - start;
+        task->used.cpu_seconds += cpu6502_sched_cpu_time() - cpu_start;
+        task->used.memory = cpu6502_ram_allocated(cpu) + task->extra_memory +
+          task->swapped_memory;
+        cpu6502_sched_check_limits(sched, index);
+      }
+    }
+    cpu6502_sched_adapt(sched);
+    sched->now = round_end;
+  }
+  cpu6502_events_run(&sched->events, sched->now);
+}
+
+#endif /* CPU6502_SCHED_H */
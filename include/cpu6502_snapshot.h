@@ -0,0 +1,235 @@
+/* Include guard */
+#if !defined(CPU6502_SNAPSHOT_H)
+#define CPU6502_SNAPSHOT_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu6502.h"
+
+/* Constants */
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_LITERALS 128
+
+/*
+ * Compressed copy of a machine: everything but the RAM pointers, then a
+ * flag for each block of RAM, then the contents of the allocated blocks.
+ * It is only meant to be restored by the same build.
+ */
+struct cpu6502_snapshot {
+  uint8_t *data;        /* The compressed state, or NULL */
+  size_t size;          /* Size of the compressed state, in bytes */
+  size_t raw_size;      /* Size of the state before compression, in bytes */
+};
+
+/*
+ * A small LZ77 compressor, fast rather than thorough.
+ * The output is a run of tokens. A token below 0x80 is followed by that
+ * many literal bytes plus one. Otherwise its low 7 bits plus
+ * LZ_MIN_MATCH are the length of a match (with 0x7f meaning more length
+ * bytes follow, each 0xff continuing), then a 2-byte offset back to it.
+ * Matches may overlap themselves, so repeated fill patterns shrink well.
+ */
+/* Get the largest size src_size bytes could compress to */
+static size_t cpu6502_compress_bound(size_t src_size) {
+  return src_size + src_size / LZ_MAX_LITERALS + 1;
+}
+/* Hash the 4 bytes at p */
+static size_t cpu6502_compress_hash(const uint8_t *p) {
+  uint32_t word;
+  memcpy(&word, p, 4);
+  return (word * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+/* Copy literals to the output, returning its new size */
+static size_t cpu6502_compress_literals(
+    uint8_t *dst,
+    size_t out,
+    const uint8_t *src,
+    size_t size) {
+  size_t n;
+  while (size > 0) {
+    n = size < LZ_MAX_LITERALS ? size : LZ_MAX_LITERALS;
+    dst[out++] = (uint8_t)(n - 1);
+    memcpy(dst + out, src, n);
+    out += n;
+    src += n;
+    size -= n;
+  }
+  return out;
+}
+/* Compress src into dst, which holds the bound, returning the size */
+static size_t cpu6502_compress(uint8_t *dst, const uint8_t *src, size_t size) {
+  size_t table[1 << LZ_HASH_BITS] = { 0 };
+  size_t in = 0, out = 0, literals = 0, hash, match, len, n;
+  while (in + LZ_MIN_MATCH <= size) {
+    hash = cpu6502_compress_hash(src + in);
+    /* Positions are stored plus one, so 0 means empty */
+    match = table[hash];
+    table[hash] = in + 1;
+    if (!match || in - (match - 1) > 0xffff ||
+        memcmp(src + match - 1, src + in, LZ_MIN_MATCH)) {
+      in++;
+      continue;
+    }
+    match--;
+    len = LZ_MIN_MATCH;
+    while (in + len < size && src[match + len] == src[in + len])
+      len++;
+    out = cpu6502_compress_literals(dst, out, src + literals, in - literals);
+    /* A match takes no more room than the literals it replaces */
+    n = len - LZ_MIN_MATCH;
+    if (n < 0x7f) {
+      dst[out++] = (uint8_t)(0x80 | n);
+    } else {
+      dst[out++] = 0xff;
+      for (n -= 0x7f; n >= 0xff; n -= 0xff)
+        dst[out++] = 0xff;
+      dst[out++] = (uint8_t)n;
+    }
+    dst[out++] = (uint8_t)(in - match);
+    dst[out++] = (uint8_t)((in - match) >> 8);
+    in += len;
+    literals = in;
+  }
+  return cpu6502_compress_literals(dst, out, src + literals, size - literals);
+}
+/* Decompress exactly dst_size bytes into dst (0 on success) */
+static int cpu6502_decompress(
+    uint8_t *dst,
+    size_t dst_size,
+    const uint8_t *src,
+    size_t src_size) {
+  size_t in = 0, out = 0, len, offset;
+  uint8_t token;
+  while (in < src_size) {
+    token = src[in++];
+    if (token < 0x80) {
+      len = (size_t)token + 1;
+      if (len > src_size - in || len > dst_size - out) return -1;
+      memcpy(dst + out, src + in, len);
+      in += len;
+      out += len;
+      continue;
+    }
+    len = (size_t)(token & 0x7f) + LZ_MIN_MATCH;
+    if ((token & 0x7f) == 0x7f) {
+      do {
+        if (in >= src_size) return -1;
+        len += src[in];
+      } while (src[in++] == 0xff);
+    }
+    if (src_size - in < 2) return -1;
+    offset = src[in] | (size_t)src[in + 1] << 8;
+    in += 2;
+    if (!offset || offset > out || len > dst_size - out) return -1;
+    /* Byte by byte, as the match may overlap what it writes */
+    for (; len > 0; len--, out++)
+      dst[out] = dst[out - offset];
+  }
+  return out == dst_size ? 0 : -1;
+}
+
+/* Size of the part of a machine saved before its RAM */
+static size_t cpu6502_snapshot_head(void) {
+  return offsetof(struct cpu6502, blocks);
+}
+/* Offset of the part of a machine saved after its RAM pointers */
+static size_t cpu6502_snapshot_tail(void) {
+  return offsetof(struct cpu6502, read_blocks) +
+    BLOCK_COUNT * sizeof(const uint8_t *);
+}
+/* Take a compressed snapshot of a machine (0 on success) */
+static int cpu6502_snapshot_take(
+    struct cpu6502_snapshot *snap,
+    const struct cpu6502 *cpu) {
+  const size_t head = cpu6502_snapshot_head(), tail = cpu6502_snapshot_tail();
+  size_t block, raw_size, size;
+  uint8_t *raw, *p;
+  raw_size = head + sizeof(struct cpu6502) - tail + BLOCK_COUNT;
+  for (block = 0; block < BLOCK_COUNT; block++)
+    if (cpu->blocks[block]) raw_size += BLOCK_SIZE;
+  raw = malloc(raw_size);
+  snap->data = malloc(cpu6502_compress_bound(raw_size));
+  if (!raw || !snap->data) {
+    free(raw);
+    free(snap->data);
+    snap->data = NULL;
+    return -1;
+  }
+  memcpy(raw, cpu, head);
+  memcpy(raw + head, (const uint8_t *)cpu + tail, sizeof(struct cpu6502) - tail);
+  p = raw + head + sizeof(struct cpu6502) - tail;
+  for (block = 0; block < BLOCK_COUNT; block++)
+    *p++ = cpu->blocks[block] != NULL;
+  for (block = 0; block < BLOCK_COUNT; block++) {
+    if (!cpu->blocks[block]) continue;
+    memcpy(p, cpu->blocks[block], BLOCK_SIZE);
+    p += BLOCK_SIZE;
+  }
+  size = cpu6502_compress(snap->data, raw, raw_size);
+  free(raw);
+  /* Give back what the bound over-allocated */
+  p = realloc(snap->data, size ? size : 1);
+  if (p) snap->data = p;
+  snap->size = size;
+  snap->raw_size = raw_size;
+  return 0;
+}
+/* Restore a machine set up with cpu6502_init from a snapshot (0 on success) */
+static int cpu6502_snapshot_restore(
+    struct cpu6502 *cpu,
+    const struct cpu6502_snapshot *snap) {
+  const size_t head = cpu6502_snapshot_head(), tail = cpu6502_snapshot_tail();
+  const size_t regs = head + sizeof(struct cpu6502) - tail;
+  size_t block, allocated = 0;
+  struct cpu6502_hooks hooks;
+  const uint8_t *p;
+  uint8_t *raw;
+  if (snap->raw_size < regs + BLOCK_COUNT) return -1;
+  raw = malloc(snap->raw_size);
+  if (!raw) return -1;
+  if (cpu6502_decompress(raw, snap->raw_size, snap->data, snap->size)) {
+    free(raw);
+    return -1;
+  }
+  for (block = 0; block < BLOCK_COUNT; block++)
+    allocated += raw[regs + block] ? BLOCK_SIZE : 0;
+  if (snap->raw_size != regs + BLOCK_COUNT + allocated) {
+    free(raw);
+    return -1;
+  }
+  /* The pattern first, so freed blocks read as the restored one */
+  memcpy(cpu->fill_block,
+      raw + head + offsetof(struct cpu6502, fill_block) - tail, BLOCK_SIZE);
+  p = raw + regs + BLOCK_COUNT;
+  for (block = 0; block < BLOCK_COUNT; block++) {
+    if (!raw[regs + block]) {
+      cpu6502_free_block(cpu, block);
+    } else if (cpu6502_alloc_block(cpu, block)) {
+      memcpy(cpu->blocks[block], p, BLOCK_SIZE);
+      p += BLOCK_SIZE;
+    } else {
+      free(raw);
+      return -1;
+    }
+  }
+  /* Everything else, including the dirty pages */
+  hooks = cpu->hooks;
+  memcpy(cpu, raw, head);
+  memcpy((uint8_t *)cpu + tail, raw + head, sizeof(struct cpu6502) - tail);
+  cpu->hooks = hooks;
+  free(raw);
+  return 0;
+}
+/* Free a snapshot */
+static void cpu6502_snapshot_free(struct cpu6502_snapshot *snap) {
+  free(snap->data);
+  snap->data = NULL;
+  snap->size = 0;
+  snap->raw_size = 0;
+}
+
+#endif /* CPU6502_SNAPSHOT_H */
@@ -0,0 +1,477 @@
+/* Include guard */
+#if !defined(CPU6502_TRACE_H)
+#define CPU6502_TRACE_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "cpu6502.h"
+
+/* Readers seek with fseeko, as fseek's long offset stops at 2GiB on some */
+/* hosts (on 32-bit ones, also build with -D_FILE_OFFSET_BITS=64) */
+#if !defined(_POSIX_C_SOURCE) || _POSIX_C_SOURCE < 200112L
+#error "cpu6502_trace.h needs fseeko: define _POSIX_C_SOURCE"
+#endif
+
+/* Constants */
+#define TRACE_MAGIC 0x3143525432303536ull /* "6502TRC1" */
+#define TRACE_INDEX_MAGIC 0x3158444932303536ull /* "6502IDX1" */
+#define TRACE_BUFFER_SIZE 65536
+/* Size of the footer locating the keyframe index */
+#define TRACE_FOOTER_SIZE 24
+/* Record kinds after the branch kinds: end of records, and keyframe */
+#define TRACE_END 6
+#define TRACE_KEYFRAME 7
+/* Maximum number of PC or RAM ranges in a filter */
+#define TRACE_MAX_RANGES 8
+
+/* A control transfer or keyframe read back from a trace */
+struct cpu6502_trace_event {
+  unsigned kind;        /* A branch kind, or TRACE_KEYFRAME */
+  uint16_t from;        /* PC before the transfer (or at the keyframe) */
+  uint16_t to;          /* PC after the transfer (or at the keyframe) */
+  uint64_t cycle;       /* Cycle of the transfer (or the keyframe's PC) */
+  uint8_t a;            /* Accumulator, at a keyframe */
+  uint8_t x;            /* Index register X, at a keyframe */
+  uint8_t y;            /* Index register Y, at a keyframe */
+  uint8_t sp;           /* Stack pointer, at a keyframe */
+  uint8_t status;       /* Status register, at a keyframe */
+};
+
+/* An inclusive range of addresses or RAM offsets */
+struct cpu6502_trace_range {
+  uint32_t start;       /* First address or offset */
+  uint32_t end;         /* Last address or offset */
+};
+
+/*
+ * Which transfers a trace records, all of which must match.
+ * Only pages holding a PC range (or every page, without any) and the
+ * trigger addresses are flagged PAGE_FLAG_TRACE, so code elsewhere runs
+ * without calling the trace at all. The rest is checked by the trace.
+ * A filtered trace leaves gaps, so code between its records can't be
+ * rebuilt by re-decoding, though every record is still exact.
+ */
+struct cpu6502_trace_filter {
+  /* Addresses a transfer must come from or go to (none means any) */
+  struct cpu6502_trace_range pcs[TRACE_MAX_RANGES]; /* Within 0-0xffff */
+  size_t pc_count;      /* Number of PC ranges */
+  /* RAM offsets, such as banks, it must come from or go to (none: any) */
+  struct cpu6502_trace_range ram[TRACE_MAX_RANGES];
+  size_t ram_count;     /* Number of RAM ranges */
+  uint8_t opcodes[32];  /* Opcodes an instruction's transfer must be made by */
+  int opcode_count;     /* Number of opcodes, or 0 for any */
+  uint8_t kinds;        /* Bits of the branch kinds to record, or 0 for any */
+  int triggered;        /* Whether to record only between the triggers */
+  uint16_t trigger_start; /* Recording starts on a transfer to here */
+  uint16_t trigger_stop; /* And stops after a transfer from or to here */
+};
+
+/*
+ * Control-flow trace, recording only where the PC jumps.
+ * Straight-line code and branches not taken are left out; a decoder
+ * rebuilds them by walking the code from each target to the next
+ * recorded source. Each record is three varints: the source as a delta
+ * from the last target (shifted up past the 3-bit kind), the target as a
+ * delta from the source, and the cycles since the last record. Deltas
+ * are zigzag coded, so short hops take a byte. A keyframe holds the
+ * absolute cycle, PC and registers, so decoding can start from it. It
+ * follows the record of the transfer that completes an interval, and
+ * holds the state at that transfer's target, between instructions: the
+ * hook runs mid-instruction, with the PC still at the source.
+ * Finishing a trace writes an end record, then an index of the
+ * keyframes' file offsets (as varint deltas) and a footer locating it,
+ * so a trace can be split between threads without reading it first.
+ */
+struct cpu6502_trace {
+  FILE *out;            /* Where the trace is written */
+  uint8_t *buf;         /* Records not yet written */
+  size_t len;           /* Number of bytes in the buffer */
+  uint16_t last_pc;     /* Target of the last record */
+  uint64_t last_cycle;  /* Cycle of the last record */
+  uint64_t keyframe_interval; /* Records between keyframes */
+  uint64_t since_keyframe; /* Records since the last keyframe */
+  uint64_t records;     /* Number of records written */
+  uint64_t written;     /* Number of bytes written out */
+  uint8_t *index;       /* Keyframe offsets, as varint deltas */
+  size_t index_len;     /* Number of bytes in the index */
+  size_t index_capacity; /* Number of bytes allocated for the index */
+  uint64_t keyframes;   /* Number of keyframes */
+  uint64_t last_keyframe; /* Offset of the last keyframe */
+  int index_lost;       /* Whether the index ran out of memory */
+  int error;            /* Whether writing has failed */
+  struct cpu6502_trace_filter filter; /* Which transfers to record */
+  int filtered;         /* Whether to check the filter */
+  int window_open;      /* Whether the triggers are recording */
+};
+
+/* Reads a trace back */
+struct cpu6502_trace_reader {
+  FILE *in;             /* Where the trace is read from */
+  uint16_t pc;          /* Target of the last record */
+  uint64_t cycle;       /* Cycle of the last record */
+  uint64_t pos;         /* Offset in the file */
+  uint64_t end;         /* Offset to stop reading at */
+};
+
+/* Write the buffered records out (0 on success) */
+static int cpu6502_trace_flush(struct cpu6502_trace *trace) {
+  if (trace->len && fwrite(trace->buf, 1, trace->len, trace->out) != trace->len)
+    trace->error = 1;
+  trace->written += trace->len;
+  trace->len = 0;
+  return trace->error ? -1 : 0;
+}
+/* Buffer a varint */
+static void cpu6502_trace_put(struct cpu6502_trace *trace, uint64_t value) {
+  if (trace->len + 10 > TRACE_BUFFER_SIZE) cpu6502_trace_flush(trace);
+  while (value >= 0x80) {
+    trace->buf[trace->len++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  trace->buf[trace->len++] = (uint8_t)value;
+}
+/* Zigzag code a 16-bit delta, so small negative ones stay small */
+static uint64_t cpu6502_trace_zigzag(uint16_t delta) {
+  int16_t value = (int16_t)delta;
+  return value < 0 ? ((uint64_t)-(int32_t)value << 1) - 1 : (uint64_t)value << 1;
+}
+/* Start a trace, writing its header (0 on success) */
+static int cpu6502_trace_init(
+    struct cpu6502_trace *trace,
+    FILE *out,
+    uint64_t keyframe_interval) {
+  int i;
+  trace->buf = malloc(TRACE_BUFFER_SIZE);
+  if (!trace->buf) return -1;
+  trace->out = out;
+  trace->len = 0;
+  trace->last_pc = 0;
+  trace->last_cycle = 0;
+  trace->keyframe_interval = keyframe_interval ? keyframe_interval : 1;
+  trace->since_keyframe = 0;
+  trace->records = 0;
+  trace->written = 0;
+  trace->index = NULL;
+  trace->index_len = 0;
+  trace->index_capacity = 0;
+  trace->keyframes = 0;
+  trace->last_keyframe = 0;
+  trace->index_lost = 0;
+  trace->error = 0;
+  trace->filtered = 0;
+  trace->window_open = 0;
+  for (i = 0; i < 8; i++)
+    trace->buf[trace->len++] = (uint8_t)(TRACE_MAGIC >> (8 * i));
+  return 0;
+}
+/* Add the offset of the next record to the keyframe index */
+static void cpu6502_trace_index(struct cpu6502_trace *trace) {
+  uint64_t offset, delta;
+  uint8_t *index;
+  offset = trace->written + trace->len;
+  if (trace->index_lost) return;
+  if (trace->index_len + 10 > trace->index_capacity) {
+    index = realloc(trace->index, 2 * trace->index_capacity + 64);
+    if (!index) {
+      trace->index_lost = 1;
+      return;
+    }
+    trace->index = index;
+    trace->index_capacity = 2 * trace->index_capacity + 64;
+  }
+  delta = offset - trace->last_keyframe;
+  while (delta >= 0x80) {
+    trace->index[trace->index_len++] = (uint8_t)(delta | 0x80);
+    delta >>= 7;
+  }
+  trace->index[trace->index_len++] = (uint8_t)delta;
+  trace->last_keyframe = offset;
+  trace->keyframes++;
+}
+/* Record a keyframe of a machine's state, between instructions, at pc */
+/* The cycle is the one the machine starts the instruction at pc at */
+static void cpu6502_trace_keyframe(
+    struct cpu6502_trace *trace,
+    const struct cpu6502 *cpu,
+    uint16_t pc) {
+  const uint64_t cycle = cpu->cycles + cpu->cycles_behind;
+  cpu6502_trace_index(trace);
+  cpu6502_trace_put(trace, TRACE_KEYFRAME);
+  cpu6502_trace_put(trace, cycle);
+  cpu6502_trace_put(trace, pc);
+  cpu6502_trace_put(trace, cpu->a);
+  cpu6502_trace_put(trace, cpu->x);
+  cpu6502_trace_put(trace, cpu->y);
+  cpu6502_trace_put(trace, cpu->sp);
+  cpu6502_trace_put(trace, cpu->status);
+  trace->last_pc = pc;
+  trace->last_cycle = cycle;
+  trace->since_keyframe = 0;
+}
+/* Set up a filter that records everything */
+static void cpu6502_trace_filter_init(struct cpu6502_trace_filter *filter) {
+  memset(filter, 0, sizeof(*filter));
+}
+/* Record only transfers from or to addresses start to end (0 on success) */
+static int cpu6502_trace_filter_pcs(
+    struct cpu6502_trace_filter *filter,
+    uint16_t start,
+    uint16_t end) {
+  if (filter->pc_count == TRACE_MAX_RANGES) return -1;
+  filter->pcs[filter->pc_count].start = start;
+  filter->pcs[filter->pc_count++].end = end;
+  return 0;
+}
+/* Record only transfers from or to a bank of a window (0 on success) */
+static int cpu6502_trace_filter_bank(
+    struct cpu6502_trace_filter *filter,
+    const struct cpu6502 *cpu,
+    size_t window,
+    uint32_t bank) {
+  const struct cpu6502_bank *b = &cpu->banks[window];
+  if (window >= cpu->bank_count || bank >= b->count ||
+      filter->ram_count == TRACE_MAX_RANGES)
+    return -1;
+  filter->ram[filter->ram_count].start = b->base + bank * b->size;
+  filter->ram[filter->ram_count++].end = b->base + (bank + 1) * b->size - 1;
+  return 0;
+}
+/* Record only transfers made by an opcode, or by interrupts */
+static void cpu6502_trace_filter_opcode(
+    struct cpu6502_trace_filter *filter,
+    uint8_t opcode) {
+  filter->opcodes[opcode / 8] |= (uint8_t)(1 << (opcode % 8));
+  filter->opcode_count++;
+}
+/* Record only between a transfer to start and one from or to stop */
+static void cpu6502_trace_filter_trigger(
+    struct cpu6502_trace_filter *filter,
+    uint16_t start,
+    uint16_t stop) {
+  filter->triggered = 1;
+  filter->trigger_start = start;
+  filter->trigger_stop = stop;
+}
+/* Check whether an address is in one of a list of ranges */
+static int cpu6502_trace_in(
+    const struct cpu6502_trace_range *ranges,
+    size_t count,
+    uint32_t value) {
+  size_t i;
+  for (i = 0; i < count; i++)
+    if (value >= ranges[i].start && value <= ranges[i].end) return 1;
+  return 0;
+}
+/* Check whether a transfer passes a trace's filter */
+static int cpu6502_trace_wanted(
+    struct cpu6502_trace *trace,
+    struct cpu6502 *cpu,
+    enum branch_kinds_6502 kind,
+    uint16_t from,
+    uint16_t to) {
+  const struct cpu6502_trace_filter *filter = &trace->filter;
+  uint8_t opcode;
+  if (filter->triggered) {
+    if (!trace->window_open) {
+      if (to != filter->trigger_start) return 0;
+      trace->window_open = 1;
+    } else if (from == filter->trigger_stop || to == filter->trigger_stop) {
+      /* The transfer closing the window is the last one recorded */
+      trace->window_open = 0;
+    }
+  }
+  if (filter->kinds && !(filter->kinds & (1 << kind))) return 0;
+  if (filter->pc_count &&
+      !cpu6502_trace_in(filter->pcs, filter->pc_count, from) &&
+      !cpu6502_trace_in(filter->pcs, filter->pc_count, to))
+    return 0;
+  if (filter->ram_count &&
+      !cpu6502_trace_in(filter->ram, filter->ram_count,
+          cpu->page_map[from / PAGE_SIZE] + from % PAGE_SIZE) &&
+      !cpu6502_trace_in(filter->ram, filter->ram_count,
+          cpu->page_map[to / PAGE_SIZE] + to % PAGE_SIZE))
+    return 0;
+  if (filter->opcode_count && kind != BRANCH_KIND_INTERRUPT) {
+    opcode = cpu6502_peek(cpu, from);
+    if (!(filter->opcodes[opcode / 8] & (1 << (opcode % 8)))) return 0;
+  }
+  return 1;
+}
+/* Branch hook recording a control transfer */
+static void cpu6502_trace_record(
+    struct cpu6502 *cpu,
+    enum branch_kinds_6502 kind,
+    uint16_t from,
+    uint16_t to,
+    void *ctx) {
+  struct cpu6502_trace *trace = ctx;
+  if (trace->filtered && !cpu6502_trace_wanted(trace, cpu, kind, from, to))
+    return;
+  cpu6502_trace_put(trace,
+      cpu6502_trace_zigzag((uint16_t)(from - trace->last_pc)) << 3 | kind);
+  cpu6502_trace_put(trace, cpu6502_trace_zigzag((uint16_t)(to - from)));
+  cpu6502_trace_put(trace, cpu->cycles - trace->last_cycle);
+  trace->last_pc = to;
+  trace->last_cycle = cpu->cycles;
+  trace->since_keyframe++;
+  trace->records++;
+  /* The instruction is done but for the PC, so this is its end state */
+  if (trace->since_keyframe >= trace->keyframe_interval)
+    cpu6502_trace_keyframe(trace, cpu, to);
+}
+/* Start tracing a machine's transfers that pass a filter (NULL for all) */
+/* Applying a configuration keeps the trace; powering on detaches it */
+static void cpu6502_trace_attach_filtered(
+    struct cpu6502_trace *trace,
+    struct cpu6502 *cpu,
+    const struct cpu6502_trace_filter *filter) {
+  size_t page, i;
+  cpu->hooks.branch = cpu6502_trace_record;
+  cpu->hooks.branch_ctx = trace;
+  trace->filtered = filter != NULL;
+  trace->window_open = 0;
+  if (filter) trace->filter = *filter;
+  else cpu6502_trace_filter_init(&trace->filter);
+  filter = &trace->filter;
+  /* Flag only the pages a recorded transfer could come from or go to */
+  for (page = 0; page < ADDR_PAGE_COUNT; page++) {
+    if (filter->pc_count) cpu->page_flags[page] &= ~PAGE_FLAG_TRACE;
+    else cpu->page_flags[page] |= PAGE_FLAG_TRACE;
+  }
+  for (i = 0; i < filter->pc_count; i++)
+    for (page = filter->pcs[i].start / PAGE_SIZE;
+        page <= filter->pcs[i].end / PAGE_SIZE; page++)
+      cpu->page_flags[page] |= PAGE_FLAG_TRACE;
+  if (filter->triggered) {
+    cpu->page_flags[filter->trigger_start / PAGE_SIZE] |= PAGE_FLAG_TRACE;
+    cpu->page_flags[filter->trigger_stop / PAGE_SIZE] |= PAGE_FLAG_TRACE;
+  }
+  cpu6502_trace_keyframe(trace, cpu, cpu->pc);
+}
+/* Start tracing every transfer a machine makes, from a keyframe of its state */
+static void cpu6502_trace_attach(struct cpu6502_trace *trace, struct cpu6502 *cpu) {
+  cpu6502_trace_attach_filtered(trace, cpu, NULL);
+}
+/* Stop tracing a machine */
+static void cpu6502_trace_detach(struct cpu6502 *cpu) {
+  size_t page;
+  for (page = 0; page < ADDR_PAGE_COUNT; page++)
+    cpu->page_flags[page] &= ~PAGE_FLAG_TRACE;
+  cpu->hooks.branch = NULL;
+  cpu->hooks.branch_ctx = NULL;
+}
+/* Finish a trace, writing the end record and index (0 if all was written) */
+static int cpu6502_trace_free(struct cpu6502_trace *trace) {
+  uint64_t start, footer[3];
+  int i, result;
+  cpu6502_trace_put(trace, TRACE_END);
+  cpu6502_trace_flush(trace);
+  start = trace->written;
+  /* Without an index, readers find the keyframes by reading the trace */
+  if (!trace->index_lost) {
+    footer[0] = start;
+    footer[1] = trace->keyframes;
+    footer[2] = TRACE_INDEX_MAGIC;
+    if (fwrite(trace->index, 1, trace->index_len, trace->out) != trace->index_len)
+      trace->error = 1;
+    for (i = 0; i < TRACE_FOOTER_SIZE; i++)
+      trace->buf[i] = (uint8_t)(footer[i / 8] >> (8 * (i % 8)));
+    if (fwrite(trace->buf, 1, TRACE_FOOTER_SIZE, trace->out) != TRACE_FOOTER_SIZE)
+      trace->error = 1;
+  }
+  result = fflush(trace->out) || trace->error ? -1 : 0;
+  free(trace->buf);
+  free(trace->index);
+  trace->buf = NULL;
+  trace->index = NULL;
+  return result;
+}
+
+/* Start reading a trace, checking its header (0 on success) */
+static int cpu6502_trace_open(struct cpu6502_trace_reader *reader, FILE *in) {
+  uint64_t magic = 0;
+  int i, c;
+  for (i = 0; i < 8; i++) {
+    if ((c = getc(in)) == EOF) return -1;
+    magic |= (uint64_t)c << (8 * i);
+  }
+  reader->in = in;
+  reader->pc = 0;
+  reader->cycle = 0;
+  reader->pos = 8;
+  reader->end = UINT64_MAX;
+  return magic == TRACE_MAGIC ? 0 : -1;
+}
+/* Move a reader to a keyframe, to read up to an offset (0 on success) */
+static int cpu6502_trace_seek(
+    struct cpu6502_trace_reader *reader,
+    uint64_t offset,
+    uint64_t end) {
+  /* An offset off_t can't hold can't be in the file */
+  if ((off_t)offset < 0 || (uint64_t)(off_t)offset != offset) return -1;
+  if (fseeko(reader->in, (off_t)offset, SEEK_SET)) return -1;
+  reader->pos = offset;
+  reader->end = end;
+  return 0;
+}
+/* Read a varint (1 if read, 0 at the end of the trace, -1 if cut short) */
+static int cpu6502_trace_get(struct cpu6502_trace_reader *reader, uint64_t *value) {
+  int c, shift = 0;
+  *value = 0;
+  while ((c = getc(reader->in)) != EOF) {
+    reader->pos++;
+    if (shift > 63) return -1;
+    *value |= (uint64_t)(c & 0x7f) << shift;
+    if (!(c & 0x80)) return 1;
+    shift += 7;
+  }
+  return shift ? -1 : 0;
+}
+/* Undo cpu6502_trace_zigzag */
+static uint16_t cpu6502_trace_unzigzag(uint64_t value) {
+  return (uint16_t)(value & 1 ? ~(value >> 1) : value >> 1);
+}
+/* Read the next event (1 if read, 0 at the end of the trace, -1 on error) */
+static int cpu6502_trace_next(
+    struct cpu6502_trace_reader *reader,
+    struct cpu6502_trace_event *event) {
+  uint64_t head, target, cycles, regs[5];
+  int result, i;
+  if (reader->pos >= reader->end) return 0;
+  if ((result = cpu6502_trace_get(reader, &head)) <= 0) return result;
+  if (head == TRACE_END) return 0;
+  event->kind = (unsigned)(head & 7);
+  if (event->kind == TRACE_KEYFRAME) {
+    if (cpu6502_trace_get(reader, &cycles) <= 0 ||
+        cpu6502_trace_get(reader, &target) <= 0)
+      return -1;
+    for (i = 0; i < 5; i++)
+      if (cpu6502_trace_get(reader, &regs[i]) <= 0) return -1;
+    reader->pc = (uint16_t)target;
+    reader->cycle = cycles;
+    event->from = event->to = reader->pc;
+    event->cycle = cycles;
+    event->a = (uint8_t)regs[0];
+    event->x = (uint8_t)regs[1];
+    event->y = (uint8_t)regs[2];
+    event->sp = (uint8_t)regs[3];
+    event->status = (uint8_t)regs[4];
+    return 1;
+  }
+  if (cpu6502_trace_get(reader, &target) <= 0 ||
+      cpu6502_trace_get(reader, &cycles) <= 0)
+    return -1;
+  event->from = (uint16_t)(reader->pc + cpu6502_trace_unzigzag(head >> 3));
+  event->to = (uint16_t)(event->from + cpu6502_trace_unzigzag(target));
+  reader->pc = event->to;
+  reader->cycle += cycles;
+  event->cycle = reader->cycle;
+  return 1;
+}
+
+#endif /* CPU6502_TRACE_H */
@@ -0,0 +1,151 @@
+/* Include guard */
+#if !defined(CPU6502_WATCHDOG_H)
+#define CPU6502_WATCHDOG_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "cpu6502.h"
+
+/* The registers a watchdog compares, to rule out hash collisions */
+struct cpu6502_watchdog_sample {
+  uint64_t hash;        /* Hash of the registers, page map and dirty pages */
+  uint16_t pc;          /* Program counter */
+  uint8_t sp;           /* Stack pointer */
+  uint8_t a;            /* Accumulator */
+  uint8_t x;            /* Index register X */
+  uint8_t y;            /* Index register Y */
+  uint8_t status;       /* Status register */
+  size_t cycles_behind; /* Number of cycles the CPU is behind */
+  uint8_t nmi_pending;  /* An NMI edge is waiting to be serviced */
+  uint8_t irq_line;     /* The IRQ line is asserted */
+};
+
+/*
+ * Runaway detection.
+ * Every interval cycles the watchdog samples a hash of the registers, the
+ * interrupt inputs, the page map (which banks are switched in) and the
+ * contents of the dirty pages (the rest of RAM still holds the image).
+ * The samples are a sequence where each follows from the last, so Brent's
+ * algorithm finds a repeat in it if there is one. A repeat with no I/O
+ * since means the machine will loop forever, unless two different RAM
+ * contents happened to hash the same; the registers are compared in full.
+ * Any I/O or interrupt starts the search over, and so does having anything
+ * due: a machine with devices attached (which keep a due cycle set) is
+ * never found looping.
+ */
+struct cpu6502_watchdog {
+  uint64_t interval;    /* Number of cycles between samples */
+  uint64_t next;        /* Cycle of the next sample */
+  uint64_t io_activity; /* The machine's I/O activity at the last sample */
+  struct cpu6502_watchdog_sample saved; /* Brent's saved sample */
+  uint64_t power;       /* Brent's power of two */
+  uint64_t lambda;      /* Samples since the saved one */
+  int started;          /* Whether there is a saved sample */
+};
+
+/* Set up a watchdog for a machine, sampling every interval cycles */
+/* (at least every cycle: an interval of 0 would see no progress at all) */
+static void cpu6502_watchdog_init(
+    struct cpu6502_watchdog *wd,
+    const struct cpu6502 *cpu,
+    uint64_t interval) {
+  if (interval == 0) interval = 1;
+  wd->interval = interval;
+  wd->next = cpu->cycles + interval;
+  wd->started = 0;
+}
+/* Mix 8 bytes into a hash */
+static uint64_t cpu6502_watchdog_mix(uint64_t hash, uint64_t value) {
+  hash = (hash ^ value) * 0x9e3779b97f4a7c15ull;
+  return hash ^ (hash >> 32);
+}
+/* Sample the state of a machine */
+static struct cpu6502_watchdog_sample cpu6502_watchdog_sample(
+    const struct cpu6502 *cpu) {
+  struct cpu6502_watchdog_sample sample;
+  uint64_t hash = 0, word;
+  size_t block, bit, i;
+  const uint8_t *page;
+  /* Clean pages are the same every time, so only dirty pages count */
+  for (block = 0; block < BLOCK_COUNT; block++) {
+    if (!cpu->dirty[block]) continue;
+    hash = cpu6502_watchdog_mix(hash, block);
+    hash = cpu6502_watchdog_mix(hash, cpu->dirty[block]);
+    for (bit = 0; bit < 64; bit++) {
+      if (!(cpu->dirty[block] & ((uint64_t)1 << bit))) continue;
+      page = cpu->blocks[block] + bit * PAGE_SIZE;
+      for (i = 0; i < PAGE_SIZE; i += 8) {
+        memcpy(&word, page + i, 8);
+        hash = cpu6502_watchdog_mix(hash, word);
+      }
+    }
+  }
+  sample.pc = cpu->pc;
+  sample.sp = cpu->sp;
+  sample.a = cpu->a;
+  sample.x = cpu->x;
+  sample.y = cpu->y;
+  sample.status = cpu->status;
+  sample.cycles_behind = cpu->cycles_behind;
+  sample.nmi_pending = cpu->nmi_pending;
+  sample.irq_line = cpu->irq_line;
+  /* The same RAM behind a different bank is a different state */
+  for (i = 0; i < ADDR_PAGE_COUNT; i++)
+    hash = cpu6502_watchdog_mix(hash, cpu->page_map[i]);
+  hash = cpu6502_watchdog_mix(hash, cpu->pc | (uint64_t)cpu->sp << 16 |
+      (uint64_t)cpu->a << 24 | (uint64_t)cpu->x << 32 |
+      (uint64_t)cpu->y << 40 | (uint64_t)cpu->status << 48 |
+      (uint64_t)cpu->nmi_pending << 56 | (uint64_t)cpu->irq_line << 57);
+  sample.hash = cpu6502_watchdog_mix(hash, cpu->cycles_behind);
+  return sample;
+}
+/* Take a sample, returning whether the machine is looping */
+static int cpu6502_watchdog_check(
+    struct cpu6502_watchdog *wd,
+    const struct cpu6502 *cpu) {
+  struct cpu6502_watchdog_sample sample = cpu6502_watchdog_sample(cpu);
+  /* I/O could break the loop, as could anything falling due (such as a */
+  /* device's timer), so start again from here */
+  if (!wd->started || cpu->io_activity != wd->io_activity ||
+      cpu->hooks.due_cycle != UINT64_MAX) {
+    wd->io_activity = cpu->io_activity;
+    wd->saved = sample;
+    wd->power = 1;
+    wd->lambda = 1;
+    wd->started = 1;
+    return 0;
+  }
+  if (sample.hash == wd->saved.hash && sample.pc == wd->saved.pc &&
+      sample.sp == wd->saved.sp && sample.a == wd->saved.a &&
+      sample.x == wd->saved.x && sample.y == wd->saved.y &&
+      sample.status == wd->saved.status &&
+      sample.cycles_behind == wd->saved.cycles_behind &&
+      sample.nmi_pending == wd->saved.nmi_pending &&
+      sample.irq_line == wd->saved.irq_line)
+    return 1;
+  /* Move the saved sample up to this one at each power of two */
+  if (wd->power == wd->lambda) {
+    wd->saved = sample;
+    wd->power *= 2;
+    wd->lambda = 0;
+  }
+  wd->lambda++;
+  return 0;
+}
+/* Run a machine until a cycle, stopping early if it is looping */
+static enum stop_reasons_6502 cpu6502_watchdog_run(
+    struct cpu6502_watchdog *wd,
+    struct cpu6502 *cpu,
+    uint64_t until) {
+  while (cpu->cycles < until) {
+    cpu6502_run(cpu, wd->next < until ? wd->next : until);
+    if (cpu->cycles < wd->next) break;
+    wd->next += wd->interval;
+    if (cpu6502_watchdog_check(wd, cpu)) return STOP_REASON_LOOP;
+  }
+  return STOP_REASON_CYCLE_LIMIT;
+}
+
+#endif /* CPU6502_WATCHDOG_H */
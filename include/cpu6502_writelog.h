@@ -0,0 +1,240 @@
+/* Include guard */
+#if !defined(CPU6502_WRITELOG_H)
+#define CPU6502_WRITELOG_H
+
+/* Includes */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cpu6502.h"
+
+/* Constants */
+/* Each sorted run is over twice the next, so 64 are enough for any log */
+#define WRITE_LOG_MAX_RUNS 64
+
+/* A logged write */
+struct cpu6502_write_entry {
+  uint64_t cycle;       /* Cycle the write happened on */
+  uint16_t pc;          /* Program counter of the writing instruction */
+  uint16_t addr;        /* Address written */
+  uint8_t old_value;    /* Value before the write */
+  uint8_t new_value;    /* Value written */
+};
+
+/* Called for each entry a range query finds */
+typedef void (*cpu6502_write_entry_fn)(
+    const struct cpu6502_write_entry *entry, void *ctx);
+
+/*
+ * Log of the writes to some pages, in the order they happened.
+ * Recording only appends, from the write hook of the logged pages, so
+ * unlogged pages run at full speed. The index of entries by address (then
+ * time) is a few sorted runs, oldest and largest first. A query after the
+ * log has grown sorts the new entries into a run of their own, merging
+ * runs only while one isn't over twice the size of the next. Each entry
+ * is so merged a logarithmic number of times, and a query binary searches
+ * each run, rather than merging the whole index each time.
+ */
+struct cpu6502_write_log {
+  struct cpu6502_write_entry *entries; /* The writes, oldest first */
+  size_t count;         /* Number of entries */
+  size_t capacity;      /* Number of entries allocated */
+  uint64_t dropped;     /* Writes not logged, for lack of memory */
+  uint64_t *index;      /* Address << 40 | entry, sorted within each run */
+  uint64_t *scratch;    /* Room to merge runs in, as large as the index */
+  size_t indexed;       /* Number of entries in the index */
+  size_t run_ends[WRITE_LOG_MAX_RUNS]; /* Index position each run ends at */
+  size_t run_count;     /* Number of runs */
+};
+
+/* Set up an empty write log (0 on success) */
+static int cpu6502_write_log_init(struct cpu6502_write_log *log, size_t capacity) {
+  if (capacity == 0) capacity = 1;
+  log->entries = malloc(capacity * sizeof(struct cpu6502_write_entry));
+  if (!log->entries) return -1;
+  log->count = 0;
+  log->capacity = capacity;
+  log->dropped = 0;
+  log->index = NULL;
+  log->scratch = NULL;
+  log->indexed = 0;
+  log->run_count = 0;
+  return 0;
+}
+/* Free a write log */
+static void cpu6502_write_log_free(struct cpu6502_write_log *log) {
+  free(log->entries);
+  free(log->index);
+  free(log->scratch);
+  log->entries = NULL;
+  log->index = NULL;
+  log->scratch = NULL;
+  log->count = 0;
+  log->capacity = 0;
+  log->indexed = 0;
+  log->run_count = 0;
+}
+/* Write hook appending to the log */
+static void cpu6502_write_log_record(
+    struct cpu6502 *cpu,
+    uint16_t addr,
+    uint8_t value,
+    void *ctx) {
+  struct cpu6502_write_log *log = ctx;
+  struct cpu6502_write_entry *entry;
+  if (log->count == log->capacity) {
+    entry = realloc(log->entries,
+        2 * log->capacity * sizeof(struct cpu6502_write_entry));
+    if (!entry) {
+      log->dropped++;
+      return;
+    }
+    log->entries = entry;
+    log->capacity *= 2;
+  }
+  entry = &log->entries[log->count++];
+  entry->cycle = cpu->cycles;
+  entry->pc = cpu->pc;
+  entry->addr = addr;
+  entry->old_value = cpu6502_peek(cpu, addr);
+  entry->new_value = value;
+}
+/* Log writes to the pages covering addresses start to end (0 on success) */
+/* Fails if something else already has the write hook */
+static int cpu6502_write_log_attach(
+    struct cpu6502_write_log *log,
+    struct cpu6502 *cpu,
+    uint16_t start,
+    uint16_t end) {
+  size_t page;
+  /* Attaching the same log again just logs more pages */
+  if (cpu->hooks.write && (cpu->hooks.write != cpu6502_write_log_record ||
+        cpu->hooks.write_ctx != log))
+    return -1;
+  cpu->hooks.write = cpu6502_write_log_record;
+  cpu->hooks.write_ctx = log;
+  for (page = start / PAGE_SIZE; page <= (size_t)end / PAGE_SIZE; page++)
+    cpu->page_flags[page] |= PAGE_FLAG_LOG;
+  return 0;
+}
+/* Stop logging a machine's writes */
+static void cpu6502_write_log_detach(struct cpu6502 *cpu) {
+  size_t page;
+  for (page = 0; page < ADDR_PAGE_COUNT; page++)
+    cpu->page_flags[page] &= ~PAGE_FLAG_LOG;
+  cpu->hooks.write = NULL;
+  cpu->hooks.write_ctx = NULL;
+}
+/* Order index keys */
+static int cpu6502_write_log_compare(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+/* Bring the index up to date with the log (0 on success) */
+static int cpu6502_write_log_index(struct cpu6502_write_log *log) {
+  uint64_t *grown;
+  size_t i, j, k, start, middle, end, added = log->count - log->indexed;
+  if (!added) return 0;
+  grown = realloc(log->index, log->count * sizeof(uint64_t));
+  if (!grown) return -1;
+  log->index = grown;
+  grown = realloc(log->scratch, log->count * sizeof(uint64_t));
+  if (!grown) return -1;
+  log->scratch = grown;
+  /* The new entries are a run of their own */
+  for (i = log->indexed; i < log->count; i++)
+    log->index[i] = (uint64_t)log->entries[i].addr << 40 | i;
+  qsort(log->index + log->indexed, added, sizeof(uint64_t),
+      cpu6502_write_log_compare);
+  log->run_ends[log->run_count++] = log->count;
+  log->indexed = log->count;
+  /* Merge the last two runs until each is over twice the next */
+  while (log->run_count > 1) {
+    end = log->run_ends[log->run_count - 1];
+    middle = log->run_ends[log->run_count - 2];
+    start = log->run_count > 2 ? log->run_ends[log->run_count - 3] : 0;
+    if (middle - start > 2 * (end - middle)) break;
+    for (i = start, j = middle, k = start; k < end; k++)
+      log->scratch[k] =
+        j == end || (i < middle && log->index[i] < log->index[j]) ?
+        log->index[i++] : log->index[j++];
+    memcpy(log->index + start, log->scratch + start,
+        (end - start) * sizeof(uint64_t));
+    log->run_ends[--log->run_count - 1] = end;
+  }
+  return 0;
+}
+/* Get the entry at a position of the index */
+static const struct cpu6502_write_entry *cpu6502_write_log_entry(
+    const struct cpu6502_write_log *log,
+    size_t pos) {
+  return &log->entries[log->index[pos] & (((uint64_t)1 << 40) - 1)];
+}
+/* Find the first position of a run with a key at or above key */
+static size_t cpu6502_write_log_lower(
+    const struct cpu6502_write_log *log,
+    size_t run,
+    uint64_t key) {
+  size_t lo = run ? log->run_ends[run - 1] : 0, hi = log->run_ends[run], mid;
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    if (log->index[mid] < key) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+/* Find the last write to addr before cycle, or NULL */
+static const struct cpu6502_write_entry *cpu6502_write_log_last(
+    struct cpu6502_write_log *log,
+    uint16_t addr,
+    uint64_t cycle) {
+  const struct cpu6502_write_entry *entry, *found = NULL;
+  size_t run, first, lo, hi, mid;
+  if (cpu6502_write_log_index(log)) return NULL;
+  for (run = 0; run < log->run_count; run++) {
+    first = lo = cpu6502_write_log_lower(log, run, (uint64_t)addr << 40);
+    hi = cpu6502_write_log_lower(log, run, (uint64_t)(addr + 1) << 40);
+    /* An address's entries are in time order, so search them by cycle */
+    while (lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      if (cpu6502_write_log_entry(log, mid)->cycle < cycle) lo = mid + 1;
+      else hi = mid;
+    }
+    if (lo == first) continue;
+    /* The latest of each run's last writes (entries are in time order) */
+    entry = cpu6502_write_log_entry(log, lo - 1);
+    if (!found || entry > found) found = entry;
+  }
+  return found;
+}
+/* Pass every write to addresses start to end (inclusive) to a callback */
+/* They are in address order, then time order; returns how many */
+static size_t cpu6502_write_log_range(
+    struct cpu6502_write_log *log,
+    uint16_t start,
+    uint16_t end,
+    cpu6502_write_entry_fn fn,
+    void *ctx) {
+  size_t next[WRITE_LOG_MAX_RUNS], last[WRITE_LOG_MAX_RUNS];
+  size_t run, best, count = 0;
+  if (cpu6502_write_log_index(log)) return 0;
+  for (run = 0; run < log->run_count; run++) {
+    next[run] = cpu6502_write_log_lower(log, run, (uint64_t)start << 40);
+    last[run] = cpu6502_write_log_lower(log, run, ((uint64_t)end + 1) << 40);
+  }
+  /* Merge the runs' parts in the range, taking the lowest key each time */
+  for (;;) {
+    best = log->run_count;
+    for (run = 0; run < log->run_count; run++)
+      if (next[run] < last[run] && (best == log->run_count ||
+            log->index[next[run]] < log->index[next[best]]))
+        best = run;
+    if (best == log->run_count) break;
+    fn(cpu6502_write_log_entry(log, next[best]++), ctx);
+    count++;
+  }
+  return count;
+}
+
+#endif /* CPU6502_WRITELOG_H */
@@ -0,0 +1,158 @@
+/*
+ * Machine descriptions, written out, parsed and powered on.
+ * Numbers are decimal even with leading zeros, so "01000000" is a
+ * million and "0256" is page 1, not octal. Descriptions naming a 65C02
+ * or a rom file that doesn't fill its range are refused. A machine
+ * powered on as described starts from the rom's reset vector, ignores
+ * writes to rom and switches banks.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cpu6502_config.h"
+
+/* Constants */
+#define ROM_START           0xc000
+#define ROM_SIZE            0x4000
+#define BANK_REG            0x6020
+#define BANK_WINDOW         0x8000
+#define BANK_BASE           0x10000
+#define BANK_SIZE           0x4000
+
+/* A description of a machine with RAM, ROM, banks and wait states */
+static const char board[] =
+  "# test board\n"
+  "clock = 01000000   ; 1 MHz\n"
+  "cpu = 6502\n"
+  "ram = 0x0000-0x3fff\n"
+  "wait = 0256-0x1ff 3\n"
+  "bank = 0x6020 0x8000-0xbfff 0x10000 4\n"
+  "rom = 0xc000-0xffff rom.bin\n";
+
+/* Directory the files are written to */
+static char dir[] = "/tmp/cpu6502_config_XXXXXX";
+/* The parsed description and the machine powered on from it */
+static struct cpu6502_config config;
+static struct cpu6502 cpu;
+/* Number of failed checks */
+static int failures;
+
+/* Count a failed check */
+static void expect(int ok, const char *what) {
+  if (ok) return;
+  fprintf(stderr, "config: %s\n", what);
+  failures++;
+}
+/* Path of a file in the directory */
+static const char *path(const char *name) {
+  static char buf[sizeof(dir) + 32];
+  snprintf(buf, sizeof(buf), "%s/%s", dir, name);
+  return buf;
+}
+/* Write a file to the directory (0 on success) */
+static int put(const char *name, const void *data, size_t size) {
+  FILE *f = fopen(path(name), "wb");
+  int result;
+  if (!f) return -1;
+  result = fwrite(data, 1, size, f) != size;
+  return fclose(f) || result ? -1 : 0;
+}
+/* Parse a description given as text (0 on success) */
+static int parse(const char *text) {
+  if (put("board.cfg", text, strlen(text))) return -1;
+  return cpu6502_config_parse(&config, path("board.cfg"));
+}
+
+/* The numbers, ranges and tables parsed from a description */
+static void test_parse(void) {
+  size_t page;
+  int waits = 1;
+  if (parse(board)) {
+    fprintf(stderr, "config: %s\n", config.error);
+    failures++;
+    return;
+  }
+  expect(config.clock_hz == 1000000, "leading zero read as octal");
+  expect(config.variant == CPU_VARIANT_NMOS, "cpu variant");
+  for (page = 0; page < ADDR_PAGE_COUNT; page++)
+    if (config.wait_states[page] != (page == 1 ? 3 : 0)) waits = 0;
+  expect(waits, "wait states not on page 1 alone");
+  expect(config.bank_count == 1 && config.banks[0].reg == BANK_REG &&
+      config.banks[0].window == BANK_WINDOW &&
+      config.banks[0].base == BANK_BASE && config.banks[0].count == 4,
+      "bank");
+  expect(config.page_flags[ROM_START / PAGE_SIZE] & PAGE_FLAG_ROM,
+      "rom not flagged");
+  expect(config.image[ROM_START] == 0xea, "rom not loaded");
+}
+/* Descriptions that must be refused */
+static void test_refused(void) {
+  static const char *const refused[] = {
+    "cpu = 65c02\n",
+    "rom = 0xc000-0xffff short.bin\n",
+    "rom = 0xc000-0xffff long.bin\n",
+    "clock = 0x\n",
+    "ram = 0x0000-0x00fe\n",
+  };
+  size_t i;
+  for (i = 0; i < sizeof(refused) / sizeof(refused[0]); i++) {
+    config.error[0] = 0;
+    if (parse(refused[i]) != -1 || !config.error[0]) {
+      fprintf(stderr, "config: accepted %s", refused[i]);
+      failures++;
+    }
+  }
+}
+/* A machine powered on as described */
+static void test_power_on(void) {
+  if (parse(board) || cpu6502_config_power_on(&cpu, &config, 0)) {
+    expect(0, "can't power on");
+    return;
+  }
+  expect(cpu.pc == ROM_START, "didn't start from the reset vector");
+  /* Writes to rom are ignored */
+  cpu6502_write(&cpu, ROM_START, 0x00);
+  expect(cpu6502_peek(&cpu, ROM_START) == 0xea, "rom was written");
+  /* Bank 2 holds what was written to it while it was switched in */
+  cpu6502_write(&cpu, BANK_REG, 2);
+  expect(cpu.page_map[BANK_WINDOW / PAGE_SIZE] == BANK_BASE + 2 * BANK_SIZE,
+      "bank 2 not switched in");
+  cpu6502_write(&cpu, BANK_WINDOW, 0x5a);
+  cpu6502_write(&cpu, BANK_REG, 0);
+  expect(cpu6502_peek(&cpu, BANK_WINDOW) == 0x00, "banks share RAM");
+  cpu6502_write(&cpu, BANK_REG, 2);
+  expect(cpu6502_peek(&cpu, BANK_WINDOW) == 0x5a, "bank 2 lost its write");
+  /* The ram is the rom's program's to use */
+  cpu6502_write(&cpu, 0x0100, 0x77);
+  expect(cpu6502_peek(&cpu, 0x0100) == 0x77, "ram not writable");
+}
+
+int main(void) {
+  static uint8_t rom[ROM_SIZE + 1];
+  static const char *const files[] = {
+    "board.cfg", "rom.bin", "short.bin", "long.bin",
+  };
+  size_t i;
+  if (!mkdtemp(dir)) {
+    fprintf(stderr, "config: can't create a directory\n");
+    return 1;
+  }
+  /* NOPs, with the reset vector pointing at the first */
+  memset(rom, 0xea, sizeof(rom));
+  rom[RESET_VECTOR - ROM_START] = ROM_START & 0xff;
+  rom[RESET_VECTOR - ROM_START + 1] = ROM_START >> 8;
+  expect(!put("rom.bin", rom, ROM_SIZE) &&
+      !put("short.bin", rom, ROM_SIZE - 1) &&
+      !put("long.bin", rom, ROM_SIZE + 1), "can't write rom files");
+  cpu6502_init(&cpu);
+  test_parse();
+  test_refused();
+  test_power_on();
+  cpu6502_free(&cpu);
+  for (i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+    unlink(path(files[i]));
+  rmdir(dir);
+  if (!failures) printf("config: ok\n");
+  return failures != 0;
+}
@@ -0,0 +1,189 @@
+/*
+ * The C core against documented NMOS 6502 behaviour.
+ * Decimal arithmetic (with the NMOS flags), the cycles instructions take
+ * (page crossings and taken branches included), interrupts, and calling
+ * a routine with cpu6502_call.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "cpu6502.h"
+
+/* Where programs are put */
+#define PROGRAM             0x0200
+#define IRQ_HANDLER         0x0400
+#define NMI_HANDLER         0x0500
+
+/* The machine under test */
+static struct cpu6502 cpu;
+/* Number of failed checks */
+static int failures;
+
+/* Count a failed check */
+static void expect(int ok, const char *what, unsigned which) {
+  if (ok) return;
+  fprintf(stderr, "core: %s (case %u)\n", what, which);
+  failures++;
+}
+/* Power on with a program at an address, run from there once reset */
+static void load(const uint8_t *program, size_t size, uint16_t at) {
+  static const uint8_t vectors[] = {
+    NMI_HANDLER & 0xff, NMI_HANDLER >> 8,
+    PROGRAM & 0xff, PROGRAM >> 8,
+    IRQ_HANDLER & 0xff, IRQ_HANDLER >> 8,
+  };
+  cpu6502_power_on(&cpu, 0);
+  cpu6502_store(&cpu, NMI_VECTOR, vectors, sizeof(vectors));
+  cpu6502_store(&cpu, at, program, size);
+  cpu6502_reset(&cpu);
+  cpu6502_branch(&cpu, BRANCH_KIND_JUMP, at);
+  while (cpu.cycles_behind) cpu6502_step(&cpu);
+}
+/* Run one instruction (or interrupt), returning the cycles it took */
+static uint64_t instruction(void) {
+  uint64_t start = cpu.cycles;
+  do cpu6502_step(&cpu); while (cpu.cycles_behind);
+  return cpu.cycles - start;
+}
+
+/* Decimal arithmetic: SED, CLC or SEC, LDA #a, then ADC or SBC #operand */
+static void test_decimal(void) {
+  static const struct {
+    uint8_t opcode, carry, a, operand, result, carry_out, zero;
+  } cases[] = {
+    { 0x69, 0, 0x12, 0x34, 0x46, 0, 0 },
+    { 0x69, 0, 0x58, 0x46, 0x04, 1, 0 },
+    { 0x69, 1, 0x15, 0x26, 0x42, 0, 0 },
+    { 0x69, 0, 0x81, 0x92, 0x73, 1, 0 },
+    /* The NMOS Z flag comes from the binary sum, 0x9a here */
+    { 0x69, 0, 0x99, 0x01, 0x00, 1, 0 },
+    { 0xe9, 1, 0x46, 0x12, 0x34, 1, 0 },
+    { 0xe9, 1, 0x40, 0x13, 0x27, 1, 0 },
+    { 0xe9, 0, 0x32, 0x02, 0x29, 1, 0 },
+    { 0xe9, 1, 0x12, 0x21, 0x91, 0, 0 },
+    { 0xe9, 1, 0x21, 0x34, 0x87, 0, 0 },
+    { 0xe9, 1, 0x50, 0x50, 0x00, 1, 1 },
+  };
+  uint8_t program[7];
+  unsigned i;
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    program[0] = 0xf8;
+    program[1] = cases[i].carry ? 0x38 : 0x18;
+    program[2] = 0xa9;
+    program[3] = cases[i].a;
+    program[4] = cases[i].opcode;
+    program[5] = cases[i].operand;
+    program[6] = 0xea;
+    load(program, sizeof(program), PROGRAM);
+    while (cpu.pc != PROGRAM + 6) instruction();
+    expect(cpu.a == cases[i].result, "decimal result", i);
+    expect(cpu.flags.c == cases[i].carry_out, "decimal carry", i);
+    expect(cpu.flags.z == cases[i].zero, "decimal zero flag", i);
+  }
+}
+
+/* Cycles taken by single instructions */
+static void test_cycles(void) {
+  static const struct {
+    uint16_t at;
+    uint8_t program[3];
+    uint8_t x, y, zero;
+    uint64_t cycles;
+  } cases[] = {
+    { PROGRAM, { 0xa9, 0x01 }, 0, 0, 0, 2 },          /* LDA # */
+    { PROGRAM, { 0xe6, 0x10 }, 0, 0, 0, 5 },          /* INC zp */
+    { PROGRAM, { 0xbd, 0x00, 0x12 }, 0x10, 0, 0, 4 }, /* LDA abs,X */
+    { PROGRAM, { 0xbd, 0xf8, 0x12 }, 0x10, 0, 0, 5 }, /* ... crossing */
+    { PROGRAM, { 0x9d, 0x00, 0x12 }, 0x10, 0, 0, 5 }, /* STA abs,X */
+    { PROGRAM, { 0xb1, 0x20 }, 0, 0x00, 0, 5 },       /* LDA (zp),Y */
+    { PROGRAM, { 0xb1, 0x20 }, 0, 0x10, 0, 6 },       /* ... crossing */
+    { PROGRAM, { 0x20, 0x00, 0x03 }, 0, 0, 0, 6 },    /* JSR */
+    { PROGRAM, { 0x48 }, 0, 0, 0, 3 },                /* PHA */
+    { PROGRAM, { 0x68 }, 0, 0, 0, 4 },                /* PLA */
+    { PROGRAM, { 0xd0, 0x10 }, 0, 0, 1, 2 },          /* BNE not taken */
+    { PROGRAM, { 0xd0, 0x10 }, 0, 0, 0, 3 },          /* BNE taken */
+    { 0x02f0, { 0xd0, 0x20 }, 0, 0, 0, 4 },           /* ... crossing */
+  };
+  static const uint8_t pointer[] = { 0xf8, 0x12 };
+  unsigned i;
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    load(cases[i].program, sizeof(cases[i].program), cases[i].at);
+    cpu6502_store(&cpu, 0x20, pointer, sizeof(pointer));
+    cpu.x = cases[i].x;
+    cpu.y = cases[i].y;
+    cpu.flags.z = cases[i].zero;
+    expect(instruction() == cases[i].cycles, "instruction cycles", i);
+  }
+}
+
+/* IRQ masking, NMI priority, what an interrupt pushes, and RTI */
+static void test_interrupts(void) {
+  static const uint8_t nops[] = { 0xea, 0xea, 0xea };
+  static const uint8_t rti[] = { 0x40 };
+  load(nops, sizeof(nops), PROGRAM);
+  cpu6502_store(&cpu, IRQ_HANDLER, rti, sizeof(rti));
+  /* Masked: the NOP runs */
+  cpu6502_irq(&cpu, 1);
+  instruction();
+  expect(cpu.pc == PROGRAM + 1, "masked IRQ was taken", 0);
+  /* Unmasked: taken in 7 cycles, pushing the PC and status */
+  cpu.status = STATUS_FLAG_C;
+  expect(instruction() == 7, "IRQ cycles", 1);
+  expect(cpu.pc == IRQ_HANDLER, "IRQ vector", 2);
+  expect(cpu.flags.i == 1, "IRQ didn't mask IRQs", 3);
+  expect(cpu.sp == 0xfc, "IRQ stack pointer", 4);
+  expect(cpu6502_peek(&cpu, 0x1ff) == (PROGRAM + 1) >> 8 &&
+      cpu6502_peek(&cpu, 0x1fe) == ((PROGRAM + 1) & 0xff), "IRQ pushed PC", 5);
+  expect(cpu6502_peek(&cpu, 0x1fd) ==
+      (STATUS_FLAG_U | STATUS_FLAG_C), "IRQ pushed status", 6);
+  /* RTI restores the PC and unmasks */
+  cpu6502_irq(&cpu, 0);
+  expect(instruction() == 6, "RTI cycles", 7);
+  expect(cpu.pc == PROGRAM + 1 && cpu.flags.i == 0 && cpu.sp == 0xff,
+      "RTI didn't return", 8);
+  /* NMI first, even masked, when both are pending */
+  cpu.flags.i = 1;
+  cpu6502_irq(&cpu, 1);
+  cpu6502_nmi(&cpu);
+  instruction();
+  expect(cpu.pc == NMI_HANDLER, "NMI wasn't taken first", 9);
+  expect(!cpu.nmi_pending, "NMI edge wasn't consumed", 10);
+}
+
+/* cpu6502_call returning, stopping at the limit, and returning on it */
+static void test_call(void) {
+  /* 0300: CLC, ADC #5, TAX, RTS; 0310: JMP 0310 */
+  static const uint8_t routine[] = { 0x18, 0x69, 0x05, 0xaa, 0x60 };
+  static const uint8_t spin[] = { 0x4c, 0x10, 0x03 };
+  static const uint8_t rts[] = { 0x60 };
+  struct cpu6502_call_result result;
+  load(routine, sizeof(routine), 0x0300);
+  cpu6502_store(&cpu, 0x0310, spin, sizeof(spin));
+  cpu6502_store(&cpu, 0x0320, rts, sizeof(rts));
+  cpu6502_branch(&cpu, BRANCH_KIND_JUMP, PROGRAM);
+  cpu.sp = 0xf0;
+  result = cpu6502_call(&cpu, 0x0300, 3, 0, 7, 1000);
+  expect(result.reason == STOP_REASON_RETURNED, "call didn't return", 0);
+  expect(result.a == 8 && result.x == 8 && result.y == 7, "call result", 1);
+  expect(result.cycles == 2 + 2 + 2 + 6, "call cycles", 2);
+  expect(cpu.pc == PROGRAM && cpu.sp == 0xf0, "caller not restored", 3);
+  /* A routine that never returns is abandoned at the limit */
+  result = cpu6502_call(&cpu, 0x0310, 0, 0, 0, 100);
+  expect(result.reason == STOP_REASON_CYCLE_LIMIT, "spin returned", 4);
+  expect(result.cycles >= 100, "spin stopped early", 5);
+  while (cpu.cycles_behind) cpu6502_step(&cpu);
+  expect(cpu.pc == PROGRAM && cpu.sp == 0xf0, "caller not restored", 6);
+  /* An RTS finishing right on the limit returned */
+  result = cpu6502_call(&cpu, 0x0320, 0, 0, 0, 6);
+  expect(result.reason == STOP_REASON_RETURNED, "RTS on the limit", 7);
+}
+
+int main(void) {
+  cpu6502_init(&cpu);
+  test_decimal();
+  test_cycles();
+  test_interrupts();
+  test_call();
+  cpu6502_free(&cpu);
+  if (!failures) printf("core: ok\n");
+  return failures != 0;
+}
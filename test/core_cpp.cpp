@@ -0,0 +1,163 @@
+/*
+ * The C++ core against the same documented NMOS 6502 behaviour as the
+ * C core's test: decimal arithmetic, instruction cycles and interrupts,
+ * on a flat 64KiB bus.
+ */
+#include <cstdio>
+#include <cstring>
+#include "cpu6502.hpp"
+
+/* Where programs are put */
+#define PROGRAM             0x0200
+#define IRQ_HANDLER         0x0400
+#define NMI_HANDLER         0x0500
+
+/* 64KiB of RAM and nothing else */
+struct FlatBus {
+  uint8_t ram[0x10000];
+  uint8_t read(uint16_t addr) { return ram[addr]; }
+  void write(uint16_t addr, uint8_t value) { ram[addr] = value; }
+};
+
+/* The machine under test */
+static FlatBus bus;
+static Cpu6502<FlatBus> cpu(bus);
+/* Number of failed checks */
+static int failures;
+
+/* Count a failed check */
+static void expect(bool ok, const char *what, unsigned which) {
+  if (ok) return;
+  std::fprintf(stderr, "core_cpp: %s (case %u)\n", what, which);
+  failures++;
+}
+/* Clear RAM with a program at an address, run from there once reset */
+static void load(const uint8_t *program, size_t size, uint16_t at) {
+  std::memset(bus.ram, 0, sizeof(bus.ram));
+  bus.ram[0xfffa] = NMI_HANDLER & 0xff;
+  bus.ram[0xfffb] = NMI_HANDLER >> 8;
+  bus.ram[0xfffc] = at & 0xff;
+  bus.ram[0xfffd] = at >> 8;
+  bus.ram[0xfffe] = IRQ_HANDLER & 0xff;
+  bus.ram[0xffff] = IRQ_HANDLER >> 8;
+  std::memcpy(bus.ram + at, program, size);
+  cpu.status = 0;
+  cpu.irq_line = false;
+  cpu.reset();
+  while (cpu.cycles_behind) cpu.step();
+}
+/* Run one instruction (or interrupt), returning the cycles it took */
+static uint64_t instruction() {
+  uint64_t start = cpu.cycles;
+  do cpu.step(); while (cpu.cycles_behind);
+  return cpu.cycles - start;
+}
+
+/* Decimal arithmetic: SED, CLC or SEC, LDA #a, then ADC or SBC #operand */
+static void test_decimal() {
+  static const struct {
+    uint8_t opcode, carry, a, operand, result, carry_out, zero;
+  } cases[] = {
+    { 0x69, 0, 0x12, 0x34, 0x46, 0, 0 },
+    { 0x69, 0, 0x58, 0x46, 0x04, 1, 0 },
+    { 0x69, 1, 0x15, 0x26, 0x42, 0, 0 },
+    { 0x69, 0, 0x81, 0x92, 0x73, 1, 0 },
+    /* The NMOS Z flag comes from the binary sum, 0x9a here */
+    { 0x69, 0, 0x99, 0x01, 0x00, 1, 0 },
+    { 0xe9, 1, 0x46, 0x12, 0x34, 1, 0 },
+    { 0xe9, 1, 0x40, 0x13, 0x27, 1, 0 },
+    { 0xe9, 0, 0x32, 0x02, 0x29, 1, 0 },
+    { 0xe9, 1, 0x12, 0x21, 0x91, 0, 0 },
+    { 0xe9, 1, 0x21, 0x34, 0x87, 0, 0 },
+    { 0xe9, 1, 0x50, 0x50, 0x00, 1, 1 },
+  };
+  unsigned i;
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const uint8_t program[] = {
+      0xf8, (uint8_t)(cases[i].carry ? 0x38 : 0x18),
+      0xa9, cases[i].a, cases[i].opcode, cases[i].operand, 0xea,
+    };
+    load(program, sizeof(program), PROGRAM);
+    while (cpu.pc != PROGRAM + 6) instruction();
+    expect(cpu.a == cases[i].result, "decimal result", i);
+    expect(!!(cpu.status & STATUS_FLAG_C) == cases[i].carry_out,
+        "decimal carry", i);
+    expect(!!(cpu.status & STATUS_FLAG_Z) == cases[i].zero,
+        "decimal zero flag", i);
+  }
+}
+
+/* Cycles taken by single instructions */
+static void test_cycles() {
+  static const struct {
+    uint16_t at;
+    uint8_t program[3];
+    uint8_t x, y, zero;
+    uint64_t cycles;
+  } cases[] = {
+    { PROGRAM, { 0xa9, 0x01 }, 0, 0, 0, 2 },          /* LDA # */
+    { PROGRAM, { 0xe6, 0x10 }, 0, 0, 0, 5 },          /* INC zp */
+    { PROGRAM, { 0xbd, 0x00, 0x12 }, 0x10, 0, 0, 4 }, /* LDA abs,X */
+    { PROGRAM, { 0xbd, 0xf8, 0x12 }, 0x10, 0, 0, 5 }, /* ... crossing */
+    { PROGRAM, { 0x9d, 0x00, 0x12 }, 0x10, 0, 0, 5 }, /* STA abs,X */
+    { PROGRAM, { 0xb1, 0x20 }, 0, 0x00, 0, 5 },       /* LDA (zp),Y */
+    { PROGRAM, { 0xb1, 0x20 }, 0, 0x10, 0, 6 },       /* ... crossing */
+    { PROGRAM, { 0x20, 0x00, 0x03 }, 0, 0, 0, 6 },    /* JSR */
+    { PROGRAM, { 0x48 }, 0, 0, 0, 3 },                /* PHA */
+    { PROGRAM, { 0x68 }, 0, 0, 0, 4 },                /* PLA */
+    { PROGRAM, { 0xd0, 0x10 }, 0, 0, 1, 2 },          /* BNE not taken */
+    { PROGRAM, { 0xd0, 0x10 }, 0, 0, 0, 3 },          /* BNE taken */
+    { 0x02f0, { 0xd0, 0x20 }, 0, 0, 0, 4 },           /* ... crossing */
+  };
+  unsigned i;
+  for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    load(cases[i].program, sizeof(cases[i].program), cases[i].at);
+    bus.ram[0x20] = 0xf8;
+    bus.ram[0x21] = 0x12;
+    cpu.x = cases[i].x;
+    cpu.y = cases[i].y;
+    cpu.status = cases[i].zero ? STATUS_FLAG_Z : 0;
+    expect(instruction() == cases[i].cycles, "instruction cycles", i);
+  }
+}
+
+/* IRQ masking, NMI priority, what an interrupt pushes, and RTI */
+static void test_interrupts() {
+  static const uint8_t nops[] = { 0xea, 0xea, 0xea };
+  load(nops, sizeof(nops), PROGRAM);
+  bus.ram[IRQ_HANDLER] = 0x40;
+  /* Masked: the NOP runs */
+  cpu.irq(true);
+  instruction();
+  expect(cpu.pc == PROGRAM + 1, "masked IRQ was taken", 0);
+  /* Unmasked: taken in 7 cycles, pushing the PC and status */
+  cpu.status = STATUS_FLAG_C;
+  expect(instruction() == 7, "IRQ cycles", 1);
+  expect(cpu.pc == IRQ_HANDLER, "IRQ vector", 2);
+  expect(cpu.status & STATUS_FLAG_I, "IRQ didn't mask IRQs", 3);
+  expect(cpu.sp == 0xfc, "IRQ stack pointer", 4);
+  expect(bus.ram[0x1ff] == (PROGRAM + 1) >> 8 &&
+      bus.ram[0x1fe] == ((PROGRAM + 1) & 0xff), "IRQ pushed PC", 5);
+  expect(bus.ram[0x1fd] == (STATUS_FLAG_U | STATUS_FLAG_C),
+      "IRQ pushed status", 6);
+  /* RTI restores the PC and unmasks */
+  cpu.irq(false);
+  expect(instruction() == 6, "RTI cycles", 7);
+  expect(cpu.pc == PROGRAM + 1 && !(cpu.status & STATUS_FLAG_I) &&
+      cpu.sp == 0xff, "RTI didn't return", 8);
+  /* NMI first, even masked, when both are pending */
+  cpu.status |= STATUS_FLAG_I;
+  cpu.irq(true);
+  cpu.nmi();
+  instruction();
+  expect(cpu.pc == NMI_HANDLER, "NMI wasn't taken first", 9);
+  expect(!cpu.nmi_pending, "NMI edge wasn't consumed", 10);
+}
+
+int main() {
+  test_decimal();
+  test_cycles();
+  test_interrupts();
+  if (!failures) std::printf("core_cpp: ok\n");
+  return failures != 0;
+}
@@ -0,0 +1,100 @@
+/*
+ * Migration through a stream, to a machine sharing the base image.
+ * The received machine must match the sent one, register for register
+ * and byte for byte of RAM, and keep matching it when both run on. RAM
+ * changed without dirtying pages is sent too, a receiver with another
+ * image is refused, and the stream is smaller than the machine's RAM.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "cpu6502_migrate.h"
+
+/* Constants */
+#define PROGRAM             0x0200
+#define SENT_AT             50000
+#define RUN_TO              100000
+
+/* The base image both ends share */
+static uint8_t image[0x10000];
+/* The sending and receiving machines */
+static struct cpu6502 sender, receiver;
+/* Number of failed checks */
+static int failures;
+
+/* Count a failed check */
+static void expect(int ok, const char *what) {
+  if (ok) return;
+  fprintf(stderr, "migrate: %s\n", what);
+  failures++;
+}
+/* Build an image with a program that writes a running sum through memory */
+static void build_image(void) {
+  /* LDA $20, ADC #$1d, STA $20, STA ($30),Y, INY, BNE, INC $31, JMP */
+  static const uint8_t program[] = {
+    0xa5, 0x20, 0x69, 0x1d, 0x85, 0x20, 0x91, 0x30, 0xc8, 0xd0, 0xf5,
+    0xe6, 0x31, 0x4c, PROGRAM & 0xff, PROGRAM >> 8,
+  };
+  size_t i;
+  for (i = 0; i < sizeof(image); i++)
+    image[i] = (uint8_t)(i * 13 + (i >> 8));
+  memcpy(image + PROGRAM, program, sizeof(program));
+  image[0x30] = 0x00;
+  image[0x31] = 0x10;
+  image[RESET_VECTOR] = PROGRAM & 0xff;
+  image[RESET_VECTOR + 1] = PROGRAM >> 8;
+}
+/* Check two machines hold the same state */
+static int same(const struct cpu6502 *a, const struct cpu6502 *b) {
+  size_t offset;
+  if (a->pc != b->pc || a->sp != b->sp || a->a != b->a || a->x != b->x ||
+      a->y != b->y || a->status != b->status || a->cycles != b->cycles ||
+      a->cycles_behind != b->cycles_behind ||
+      memcmp(a->page_map, b->page_map, sizeof(a->page_map)) ||
+      memcmp(a->dirty, b->dirty, sizeof(a->dirty)))
+    return 0;
+  for (offset = 0; offset < RAM_SIZE; offset++)
+    if (cpu6502_ram_read(a, offset) != cpu6502_ram_read(b, offset))
+      return 0;
+  return 1;
+}
+
+int main(void) {
+  static const uint8_t stored[] = { 0xde, 0xad };
+  FILE *stream = tmpfile();
+  long size;
+  if (!stream) {
+    fprintf(stderr, "migrate: can't open a stream\n");
+    return 1;
+  }
+  build_image();
+  cpu6502_init(&sender);
+  cpu6502_init(&receiver);
+  expect(!cpu6502_load(&sender, image, sizeof(image)), "can't load");
+  cpu6502_reset(&sender);
+  /* Some of the writes land in RAM above the address space */
+  sender.page_map[0x12] = 0x40000;
+  cpu6502_run(&sender, SENT_AT);
+  /* Stored, so not dirty, but still not the image */
+  cpu6502_store(&sender, 0x8000, stored, sizeof(stored));
+  expect(!cpu6502_migrate_send(&sender, stream, image, sizeof(image)),
+      "can't send");
+  size = ftell(stream);
+  expect(size > 0 && size < 0x10000, "stream larger than the image");
+  rewind(stream);
+  expect(!cpu6502_migrate_receive(&receiver, stream, image, sizeof(image)),
+      "can't receive");
+  expect(same(&receiver, &sender), "received machine differs");
+  cpu6502_run(&sender, RUN_TO);
+  cpu6502_run(&receiver, RUN_TO);
+  expect(same(&receiver, &sender), "received machine ran differently");
+  /* Another image can't rebuild it */
+  rewind(stream);
+  image[0x9000] ^= 1;
+  expect(cpu6502_migrate_receive(&receiver, stream, image, sizeof(image)) != 0,
+      "received with another image");
+  fclose(stream);
+  cpu6502_free(&sender);
+  cpu6502_free(&receiver);
+  if (!failures) printf("migrate: ok\n");
+  return failures != 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * Pooled machines, used from several threads at once.
+ * Each thread has its own pool, as cpu6502_pool asks, and repeatedly
+ * acquires a machine, runs a program that writes to three pages, checks
+ * the writes landed, and releases it. Jobs also leave wiring behind, and
+ * some power the machine on again. A machine acquired again must be as
+ * first powered on, reading as the image, and the counters must add up.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include "cpu6502_pool.h"
+
+/* Constants */
+#define THREADS             4
+#define MACHINES            3
+#define ROUNDS              200
+#define RUN_CYCLES          1000
+/* Pages the program writes: zero page, 0x30 and 0x41 */
+#define PAGES_WRITTEN       3
+
+/* The image every machine starts from */
+static uint8_t image[0x10000];
+
+/* What a thread found wrong, or NULL */
+struct worker {
+  struct cpu6502_pool pool; /* Its own pool */
+  const char *error;        /* The first failed check */
+};
+
+/* Build the image: INC $10, STA $3000, STA $4100, JMP $0200 */
+static void build_image(void) {
+  static const uint8_t program[] = {
+    0xe6, 0x10, 0x8d, 0x00, 0x30, 0x8d, 0x00, 0x41, 0x4c, 0x00, 0x02,
+  };
+  size_t i;
+  for (i = 0; i < sizeof(image); i++)
+    image[i] = (uint8_t)(i * 7);
+  memcpy(image + 0x0200, program, sizeof(program));
+  image[RESET_VECTOR] = 0x00;
+  image[RESET_VECTOR + 1] = 0x02;
+}
+/* A hook a job leaves behind */
+static void stray_branch(
+    struct cpu6502 *cpu,
+    enum branch_kinds_6502 kind,
+    uint16_t from,
+    uint16_t to,
+    void *ctx) {
+  (void)cpu; (void)kind; (void)from; (void)to; (void)ctx;
+}
+/* Check a machine reads as the image, freshly powered on */
+static const char *check_fresh(struct cpu6502 *cpu) {
+  size_t addr;
+  if (cpu->pc != 0x0200 || cpu->sp != 0xff || cpu->cycles_behind != 6)
+    return "acquired machine wasn't reset";
+  if (cpu->cycles || cpu->irq_line || cpu->io_activity ||
+      cpu->hooks.branch || cpu->hooks.due_cycle != UINT64_MAX ||
+      cpu->page_flags[0x30] || cpu->wait_states[0x41])
+    return "acquired machine wasn't powered on";
+  for (addr = 0; addr < sizeof(image); addr++)
+    if (cpu6502_peek(cpu, (uint16_t)addr) != image[addr])
+      return "acquired machine doesn't hold the image";
+  return NULL;
+}
+/* Run rounds of acquire, run and release on a thread's own pool */
+static int work(void *arg) {
+  struct worker *w = arg;
+  struct cpu6502 *cpus[MACHINES];
+  struct cpu6502_pool_stats stats;
+  size_t round, i;
+  for (round = 0; round < ROUNDS && !w->error; round++) {
+    for (i = 0; i < MACHINES && !w->error; i++) {
+      if (!(cpus[i] = cpu6502_pool_acquire(&w->pool)))
+        w->error = "acquire failed";
+      else
+        w->error = check_fresh(cpus[i]);
+    }
+    if (!w->error && cpu6502_pool_acquire(&w->pool))
+      w->error = "acquired more machines than the pool holds";
+    for (i = 0; i < MACHINES && !w->error; i++) {
+      cpus[i]->hooks.branch = stray_branch;
+      cpus[i]->wait_states[0x41] = 1;
+      cpu6502_run(cpus[i], RUN_CYCLES);
+      if (cpu6502_peek(cpus[i], 0x10) == image[0x10] ||
+          cpu6502_peek(cpus[i], 0x3000) != 0 ||
+          cpu6502_peek(cpus[i], 0x4100) != 0)
+        w->error = "program didn't run";
+      cpus[i]->irq_line = 1;
+      cpus[i]->page_flags[0x30] = PAGE_FLAG_ROM;
+    }
+    /* Now and then a job powers its machine on, which drops the image */
+    if (!w->error && round % 10 == 9) {
+      cpu6502_power_on(cpus[0], 0x5555555555555555ull);
+      cpu6502_run(cpus[0], RUN_CYCLES);
+    }
+    for (i = 0; i < MACHINES && !w->error; i++)
+      cpu6502_pool_release(&w->pool, cpus[i]);
+  }
+  stats = cpu6502_pool_stats(&w->pool);
+  if (!w->error &&
+      (stats.acquires != ROUNDS * MACHINES ||
+       stats.releases != ROUNDS * MACHINES ||
+       stats.pages_restored !=
+         (ROUNDS * MACHINES - ROUNDS / 10) * PAGES_WRITTEN))
+    w->error = "counters don't add up";
+  return 0;
+}
+
+int main(void) {
+  static struct worker workers[THREADS];
+  thrd_t ids[THREADS];
+  size_t i, started;
+  int failed = 0;
+  build_image();
+  for (i = 0; i < THREADS; i++)
+    if (cpu6502_pool_init(&workers[i].pool, MACHINES, image, sizeof(image))) {
+      fprintf(stderr, "pool: can't allocate a pool\n");
+      return 1;
+    }
+  for (started = 0; started < THREADS; started++)
+    if (thrd_create(&ids[started], work, &workers[started]) != thrd_success)
+      break;
+  for (i = 0; i < started; i++)
+    thrd_join(ids[i], NULL);
+  if (started < THREADS) {
+    fprintf(stderr, "pool: can't start %d threads\n", THREADS);
+    failed = 1;
+  }
+  for (i = 0; i < started; i++) {
+    if (workers[i].error) {
+      fprintf(stderr, "pool: thread %zu: %s\n", i, workers[i].error);
+      failed = 1;
+    }
+  }
+  for (i = 0; i < THREADS; i++)
+    cpu6502_pool_free(&workers[i].pool);
+  if (!failed) printf("pool: ok\n");
+  return failed;
+}
@@ -0,0 +1,107 @@
+/*
+ * Snapshots, taken of a running machine and restored.
+ * A machine restored from a snapshot must match the original as it was
+ * taken, register for register and byte for byte of RAM, then keep
+ * matching it when both run on. Restoring keeps the destination's hooks,
+ * and a damaged snapshot is refused.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "cpu6502_snapshot.h"
+
+/* Constants */
+#define PROGRAM             0x0200
+#define TAKEN_AT            50000
+#define RUN_TO              100000
+
+/* The original, a copy of it as snapshotted, and the restored machine */
+static struct cpu6502 original, taken, restored;
+/* Number of failed checks */
+static int failures;
+
+/* Count a failed check */
+static void expect(int ok, const char *what) {
+  if (ok) return;
+  fprintf(stderr, "snapshot: %s\n", what);
+  failures++;
+}
+/* A branch hook, to see that restoring keeps it */
+static void branch_hook(
+    struct cpu6502 *cpu,
+    enum branch_kinds_6502 kind,
+    uint16_t from,
+    uint16_t to,
+    void *ctx) {
+  (void)cpu; (void)kind; (void)from; (void)to;
+  (*(uint64_t *)ctx)++;
+}
+/* Power on with a program that writes a running sum through memory */
+static void start(struct cpu6502 *cpu) {
+  /* LDA $20, ADC #$1d, STA $20, STA ($30),Y, INY, BNE, INC $31, JMP */
+  static const uint8_t program[] = {
+    0xa5, 0x20, 0x69, 0x1d, 0x85, 0x20, 0x91, 0x30, 0xc8, 0xd0, 0xf5,
+    0xe6, 0x31, 0x4c, PROGRAM & 0xff, PROGRAM >> 8,
+  };
+  static const uint8_t pointer[] = { 0x00, 0x10 };
+  static const uint8_t reset[] = { PROGRAM & 0xff, PROGRAM >> 8 };
+  cpu6502_init(cpu);
+  cpu6502_power_on(cpu, 0x0123456789abcdefull);
+  cpu6502_store(cpu, PROGRAM, program, sizeof(program));
+  cpu6502_store(cpu, 0x30, pointer, sizeof(pointer));
+  cpu6502_store(cpu, RESET_VECTOR, reset, sizeof(reset));
+  cpu6502_reset(cpu);
+  /* Some of the writes land in RAM above the address space */
+  cpu->page_map[0x12] = 0x40000;
+}
+/* Check two machines hold the same state */
+static int same(const struct cpu6502 *a, const struct cpu6502 *b) {
+  size_t offset;
+  if (a->pc != b->pc || a->sp != b->sp || a->a != b->a || a->x != b->x ||
+      a->y != b->y || a->status != b->status || a->cycles != b->cycles ||
+      a->cycles_behind != b->cycles_behind ||
+      memcmp(a->page_map, b->page_map, sizeof(a->page_map)) ||
+      memcmp(a->dirty, b->dirty, sizeof(a->dirty)))
+    return 0;
+  for (offset = 0; offset < RAM_SIZE; offset++)
+    if (cpu6502_ram_read(a, offset) != cpu6502_ram_read(b, offset))
+      return 0;
+  return 1;
+}
+
+int main(void) {
+  struct cpu6502_snapshot snap, damaged;
+  uint64_t branches = 0;
+  start(&original);
+  cpu6502_run(&original, TAKEN_AT);
+  if (cpu6502_snapshot_take(&snap, &original)) {
+    fprintf(stderr, "snapshot: can't take snapshot\n");
+    return 1;
+  }
+  expect(snap.size < snap.raw_size, "snapshot didn't compress");
+  cpu6502_init(&taken);
+  expect(!cpu6502_clone(&taken, &original), "can't clone");
+  cpu6502_run(&original, RUN_TO);
+  /* Into a fresh machine, which keeps its own hooks */
+  cpu6502_init(&restored);
+  restored.hooks.branch = branch_hook;
+  restored.hooks.branch_ctx = &branches;
+  expect(!cpu6502_snapshot_restore(&restored, &snap), "can't restore");
+  expect(same(&restored, &taken), "restored machine differs");
+  expect(restored.hooks.branch == branch_hook, "restoring lost hooks");
+  cpu6502_run(&restored, RUN_TO);
+  expect(same(&restored, &original), "restored machine ran differently");
+  /* Back into the original, which has since written more of RAM */
+  expect(!cpu6502_snapshot_restore(&original, &snap), "can't restore back");
+  expect(same(&original, &taken), "machine restored back differs");
+  /* A snapshot cut short is refused */
+  damaged = snap;
+  damaged.size = snap.size / 2;
+  expect(cpu6502_snapshot_restore(&restored, &damaged) != 0,
+      "damaged snapshot restored");
+  cpu6502_snapshot_free(&snap);
+  cpu6502_free(&original);
+  cpu6502_free(&taken);
+  cpu6502_free(&restored);
+  if (!failures) printf("snapshot: ok\n");
+  return failures != 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * Traces, written by a running machine and read back.
+ * A second machine runs the same program with its own branch hook. Every
+ * record read back must be the transfer it saw, and every keyframe must
+ * hold its registers at that cycle. Analyzing the trace on one thread or
+ * several must count the same records and keyframes as reading it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cpu6502_analyze.h"
+
+/* Constants */
+#define PROGRAM             0x0200
+#define RUN_TO              200000
+#define KEYFRAME_INTERVAL   16
+/* Transfers the reference machine can have seen but not yet matched */
+#define PENDING             64
+
+/* A transfer the reference machine made */
+struct transfer {
+  unsigned kind;        /* Branch kind */
+  uint16_t from;        /* PC before */
+  uint16_t to;          /* PC after */
+  uint64_t cycle;       /* Cycle it was made on */
+};
+
+/* Transfers seen by the reference machine, oldest first */
+struct transfers {
+  struct transfer seen[PENDING];
+  size_t count;
+};
+
+/* Records and keyframes counted by analyzing */
+struct counts {
+  uint64_t records;
+  uint64_t keyframes;
+};
+
+/* The traced machine and the reference */
+static struct cpu6502 traced, reference;
+/* Number of failed checks */
+static int failures;
+
+/* Count a failed check */
+static void expect(int ok, const char *what) {
+  if (ok) return;
+  fprintf(stderr, "trace: %s\n", what);
+  failures++;
+}
+/* Branch hook of the reference machine */
+static void seen(
+    struct cpu6502 *cpu,
+    enum branch_kinds_6502 kind,
+    uint16_t from,
+    uint16_t to,
+    void *ctx) {
+  struct transfers *transfers = ctx;
+  struct transfer *t;
+  if (transfers->count == PENDING) return;
+  t = &transfers->seen[transfers->count++];
+  t->kind = kind;
+  t->from = from;
+  t->to = to;
+  t->cycle = cpu->cycles;
+}
+/* Power on with subroutine calls, branches, BRK and RTI to trace */
+static void start(struct cpu6502 *cpu) {
+  /* LDX #5, JSR 0210, DEX, BNE, BRK, JMP 0200 */
+  static const uint8_t program[] = {
+    0xa2, 0x05, 0x20, 0x10, 0x02, 0xca, 0xd0, 0xfa, 0x00, 0xea,
+    0x4c, 0x00, 0x02,
+  };
+  /* PHA, PLA, RTS */
+  static const uint8_t sub[] = { 0x48, 0x68, 0x60 };
+  /* RTI */
+  static const uint8_t handler[] = { 0x40 };
+  static const uint8_t vectors[] = { 0x00, 0x02, 0x20, 0x02 };
+  cpu6502_init(cpu);
+  cpu6502_store(cpu, PROGRAM, program, sizeof(program));
+  cpu6502_store(cpu, 0x0210, sub, sizeof(sub));
+  cpu6502_store(cpu, 0x0220, handler, sizeof(handler));
+  cpu6502_store(cpu, RESET_VECTOR, vectors, sizeof(vectors));
+  cpu6502_reset(cpu);
+}
+/* Analyzing: count records and keyframes */
+static void counts_init(void *acc, void *ctx) {
+  (void)ctx;
+  memset(acc, 0, sizeof(struct counts));
+}
+static void counts_map(
+    void *acc,
+    const struct cpu6502_trace_event *event,
+    void *ctx) {
+  struct counts *counts = acc;
+  (void)ctx;
+  if (event->kind == TRACE_KEYFRAME) counts->keyframes++;
+  else counts->records++;
+}
+static void counts_reduce(void *into, const void *acc, void *ctx) {
+  struct counts *total = into;
+  const struct counts *counts = acc;
+  (void)ctx;
+  total->records += counts->records;
+  total->keyframes += counts->keyframes;
+}
+
+/* Read the trace back against the reference machine */
+static void check_records(FILE *in, struct counts *read) {
+  struct cpu6502_trace_reader reader;
+  struct cpu6502_trace_event event;
+  struct transfers transfers = { .count = 0 };
+  size_t page;
+  int result;
+  start(&reference);
+  for (page = 0; page < ADDR_PAGE_COUNT; page++)
+    reference.page_flags[page] |= PAGE_FLAG_TRACE;
+  reference.hooks.branch = seen;
+  reference.hooks.branch_ctx = &transfers;
+  memset(read, 0, sizeof(*read));
+  expect(!cpu6502_trace_open(&reader, in), "bad trace header");
+  while ((result = cpu6502_trace_next(&reader, &event)) == 1) {
+    if (event.kind == TRACE_KEYFRAME) {
+      read->keyframes++;
+      while (reference.cycles < event.cycle) cpu6502_step(&reference);
+      if (reference.cycles_behind || reference.pc != event.to ||
+          reference.a != event.a || reference.x != event.x ||
+          reference.y != event.y || reference.sp != event.sp ||
+          reference.status != event.status) {
+        expect(0, "keyframe doesn't match the machine");
+        return;
+      }
+      continue;
+    }
+    read->records++;
+    while (!transfers.count && reference.cycles < RUN_TO)
+      cpu6502_step(&reference);
+    if (!transfers.count || transfers.seen[0].kind != event.kind ||
+        transfers.seen[0].from != event.from ||
+        transfers.seen[0].to != event.to ||
+        transfers.seen[0].cycle != event.cycle) {
+      expect(0, "record doesn't match the transfer made");
+      return;
+    }
+    memmove(transfers.seen, transfers.seen + 1,
+        --transfers.count * sizeof(struct transfer));
+  }
+  expect(result == 0, "trace cut short");
+  expect(read->records > 1000 && read->keyframes > 100, "trace too short");
+}
+
+int main(void) {
+  const struct cpu6502_trace_job job = {
+    sizeof(struct counts), counts_init, counts_map, counts_reduce, NULL,
+  };
+  char path[] = "/tmp/cpu6502_trace_XXXXXX";
+  struct cpu6502_trace trace;
+  struct counts read, analyzed;
+  size_t threads;
+  FILE *out, *in;
+  int fd = mkstemp(path);
+  if (fd < 0 || !(out = fdopen(fd, "wb"))) {
+    fprintf(stderr, "trace: can't create a trace file\n");
+    return 1;
+  }
+  start(&traced);
+  expect(!cpu6502_trace_init(&trace, out, KEYFRAME_INTERVAL), "can't trace");
+  cpu6502_trace_attach(&trace, &traced);
+  cpu6502_run(&traced, RUN_TO);
+  cpu6502_trace_detach(&traced);
+  expect(!cpu6502_trace_free(&trace), "can't finish the trace");
+  fclose(out);
+  if ((in = fopen(path, "rb"))) {
+    check_records(in, &read);
+    fclose(in);
+  } else {
+    expect(0, "can't open the trace");
+  }
+  for (threads = 1; threads <= 4; threads *= 2) {
+    expect(!cpu6502_trace_analyze(path, threads, &job, &analyzed),
+        "can't analyze");
+    expect(analyzed.records == read.records &&
+        analyzed.keyframes == read.keyframes, "analyzing counted differently");
+  }
+  unlink(path);
+  cpu6502_free(&traced);
+  cpu6502_free(&reference);
+  if (!failures) printf("trace: ok\n");
+  return failures != 0;
+}